@@ -9,169 +9,274 @@
 #include <cassert>
 
 #include <algorithm>
+#include <atomic>
+#include <cerrno>
 #include <chrono>
+#include <cmath>
+#include <cstring>
+#include <cstdlib>
 #include <ctime>
+#include <fstream>
+#include <iterator>
+#include <limits>
 #include <memory>
 #include <string>
 #include <stdexcept>
+#include <thread>
 #include <vector>
 #include <unordered_map>
+#include <unordered_set>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 namespace toml 
 {
 
+// A date_time is packed into one 64-bit word: the instant in milliseconds
+// (UTC for offset date-times, wall clock for the local kinds), the UTC offset
+// in minutes and the kind. The instant occupies the high bits, so ordering is
+// a single integer comparison; calendar fields are only derived when asked for.
 class date_time
 {
 public:
-    constexpr date_time() :
-        year_(0),
-        month_(0),
-        day_(0),
-        hour_(0),
-        minute_(0),
-        second_(0),
-        hour_offset_(0),
-        minute_offset_(0),
-        current_time_(0)
-    {}
-
-    date_time(const date_time& other) :
-        year_(other.year_),
-        month_(other.month_),
-        day_(other.day_),
-        hour_(other.hour_),
-        minute_(other.minute_),
-        second_(other.second_),
-        hour_offset_(other.hour_offset_),
-        minute_offset_(other.minute_offset_),
-        current_time_(other.current_time_)
-    {}
-
-    date_time(date_time&& other) :
-        year_(std::move(other.year_)),
-        month_(std::move(other.month_)),
-        day_(std::move(other.day_)),
-        hour_(std::move(other.hour_)),
-        minute_(std::move(other.minute_)),
-        second_(std::move(other.second_)),
-        hour_offset_(std::move(other.hour_offset_)),
-        minute_offset_(std::move(other.minute_offset_)),
-        current_time_(std::move(other.current_time_))
+    enum class kind
+    {
+        offset_date_time,
+        local_date_time,
+        local_date,
+        local_time
+    };
+
+    constexpr date_time() : rep_(pack(0, 0, kind::offset_date_time))
     {}
 
+    static inline date_time offset_date_time(int32_t year, int32_t month, int32_t day, int32_t hour, int32_t minute, int32_t second,
+                                             int32_t millisecond, int32_t offset_minutes)
+    {
+        date_time result;
+        result.set_fields(kind::offset_date_time, days_from_civil(year, month, day),
+                          time_of_day(hour, minute, second, millisecond), offset_minutes);
+        return result;
+    }
+
+    static inline date_time local_date_time(int32_t year, int32_t month, int32_t day, int32_t hour, int32_t minute, int32_t second,
+                                            int32_t millisecond = 0)
+    {
+        date_time result;
+        result.set_fields(kind::local_date_time, days_from_civil(year, month, day),
+                          time_of_day(hour, minute, second, millisecond), 0);
+        return result;
+    }
+
+    static inline date_time local_date(int32_t year, int32_t month, int32_t day)
+    {
+        date_time result;
+        result.set_fields(kind::local_date, days_from_civil(year, month, day), 0, 0);
+        return result;
+    }
+
+    static inline date_time local_time(int32_t hour, int32_t minute, int32_t second, int32_t millisecond = 0)
+    {
+        date_time result;
+        result.set_fields(kind::local_time, 0, time_of_day(hour, minute, second, millisecond), 0);
+        return result;
+    }
+
     inline void set_date(uint32_t year, uint32_t month, uint32_t day)
     {
-        set_date_time(std::move(year), std::move(month), std::move(day), hour_, minute_, second_);
+        kind new_kind = (get_kind() == kind::local_time) ? (kind::local_date_time) : (get_kind());
+        set_fields(new_kind, days_from_civil(year, month, day), floor_mod(local_milliseconds(), milliseconds_per_day), offset());
     }
 
     inline void set_time(uint32_t hour, uint32_t minute, uint32_t second)
     {
-        set_date_time(year_, month_, day_, std::move(hour), std::move(minute), std::move(second));
+        kind new_kind = (get_kind() == kind::local_date) ? (kind::local_date_time) : (get_kind());
+        set_fields(new_kind, floor_div(local_milliseconds(), milliseconds_per_day), time_of_day(hour, minute, second, 0), offset());
     }
 
     inline void set_date_time(uint32_t year, uint32_t month, uint32_t day, uint32_t hour, uint32_t minute, uint32_t second)
     {
-        year_ = std::move(year);
-        month_ = std::move(month);
-        day_ = std::move(day);
-        hour_ = std::move(hour);
-        minute_ = std::move(minute);
-        second_ = std::move(second);
+        kind new_kind = (get_kind() == kind::offset_date_time) ? (kind::offset_date_time) : (kind::local_date_time);
+        set_fields(new_kind, days_from_civil(year, month, day), time_of_day(hour, minute, second, 0), offset());
+    }
 
-        update_current_time();
+    inline void set_offset(int32_t hour_offset, int32_t minute_offset)
+    {
+        int64_t wall_clock = local_milliseconds();
+        set_fields(kind::offset_date_time, floor_div(wall_clock, milliseconds_per_day), floor_mod(wall_clock, milliseconds_per_day),
+                   hour_offset * 60 + minute_offset);
     }
     
     inline void from_utc(time_t time)
     {
-        current_time_ = time;
-        std::tm* tm = std::gmtime(&time);
-        from_utc(*tm);
+        rep_ = pack(static_cast<int64_t>(time) * 1000, 0, kind::offset_date_time);
     }
 
     inline void from_local(time_t time)
     {
-        current_time_ = time;
         std::tm* tm = std::localtime(&time);
-        from_local(*tm);
+
+        char buf[16];
+        std::strftime(buf, 16, "%z", tm);
+
+        int offset = std::stoi(buf);
+        rep_ = pack(static_cast<int64_t>(time) * 1000, (offset / 100) * 60 + (offset % 100), kind::offset_date_time);
     }
 
-    inline bool operator == (const date_time& other)
+    inline kind get_kind() const
     {
-        return (current_time_ == other.current_time_);
+        return static_cast<kind>(rep_ & 0x3);
     }
 
-    inline bool operator != (const date_time& other)
+    // The packed representation, for storing a date_time outside the
+    // process (see shared_config).
+    inline uint64_t raw() const
     {
-        return !((*this) == other);
+        return rep_;
     }
 
-    inline bool operator < (const date_time& other)
+    static inline date_time from_raw(uint64_t rep)
     {
-        if(current_time_ < other.current_time_)
-        {
-            return true;
-        }
+        date_time result;
+        result.rep_ = rep;
+        return result;
+    }
 
-        return false;
+    inline int32_t year() const
+    {
+        int32_t year, month, day;
+        civil_from_days(floor_div(local_milliseconds(), milliseconds_per_day), year, month, day);
+        return year;
     }
 
-    inline bool operator <= (const date_time& other)
+    inline int32_t month() const
     {
-        if(current_time_ <= other.current_time_)
-        {
-            return true;
-        }
+        int32_t year, month, day;
+        civil_from_days(floor_div(local_milliseconds(), milliseconds_per_day), year, month, day);
+        return month;
+    }
 
-        return false;
+    inline int32_t day() const
+    {
+        int32_t year, month, day;
+        civil_from_days(floor_div(local_milliseconds(), milliseconds_per_day), year, month, day);
+        return day;
     }
 
-    inline bool operator > (const date_time& other)
+    inline int32_t hour() const
     {
-        return !(*this <= other);
+        return static_cast<int32_t>(floor_mod(local_milliseconds(), milliseconds_per_day) / 3600000);
     }
 
-    inline bool operator >= (const date_time& other)
+    inline int32_t minute() const
     {
-        return !(*this < other);
+        return static_cast<int32_t>(floor_mod(local_milliseconds(), 3600000) / 60000);
     }
 
-    inline date_time& operator = (const date_time& other)
+    inline int32_t second() const
     {
-        year_ = other.year_;
-        month_ = other.month_;
-        day_ = other.day_;
-        hour_ = other.hour_;
-        minute_ = other.minute_;
-        second_ = other.second_;
-        hour_offset_ = other.hour_offset_;
-        minute_offset_ = other.minute_offset_;
-        current_time_ = other.current_time_;
-        
-        return *this;
+        return static_cast<int32_t>(floor_mod(local_milliseconds(), 60000) / 1000);
+    }
+
+    inline int32_t millisecond() const
+    {
+        return static_cast<int32_t>(floor_mod(local_milliseconds(), 1000));
+    }
+
+    // UTC offset in minutes; always 0 for the local kinds.
+    inline int32_t offset() const
+    {
+        return static_cast<int32_t>((rep_ >> 2) & 0xFFF) - offset_bias;
+    }
+
+    // Milliseconds since the epoch; the local kinds count as if they were UTC.
+    inline int64_t time_since_epoch() const
+    {
+        return static_cast<int64_t>(rep_ >> 14) - instant_bias;
+    }
+
+    inline time_t to_time_t() const
+    {
+        return static_cast<time_t>(floor_div(time_since_epoch(), 1000));
+    }
+
+    inline bool operator == (const date_time& other) const
+    {
+        return rep_ == other.rep_;
+    }
+
+    inline bool operator != (const date_time& other) const
+    {
+        return rep_ != other.rep_;
+    }
+
+    inline bool operator < (const date_time& other) const
+    {
+        return rep_ < other.rep_;
+    }
+
+    inline bool operator <= (const date_time& other) const
+    {
+        return rep_ <= other.rep_;
+    }
+
+    inline bool operator > (const date_time& other) const
+    {
+        return rep_ > other.rep_;
     }
 
-    inline date_time& operator = (const date_time&& other)
+    inline bool operator >= (const date_time& other) const
     {
-        year_ = std::move(other.year_);
-        month_ = std::move(other.month_);
-        day_ = std::move(other.day_);
-        hour_ = std::move(other.hour_);
-        minute_ = std::move(other.minute_);
-        second_ = std::move(other.second_);
-        hour_offset_ = std::move(other.hour_offset_);
-        minute_offset_ = std::move(other.minute_offset_);
-        current_time_ = std::move(other.current_time_);
+        return rep_ >= other.rep_;
+    }
+
+    template<class rep, class period>
+    inline date_time& operator += (const std::chrono::duration<rep, period>& duration)
+    {
+        int64_t milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(duration).count();
+        int64_t instant = time_since_epoch() + milliseconds;
+        if(get_kind() == kind::local_time)
+        {
+            instant = floor_mod(instant, milliseconds_per_day);
+        }
 
+        rep_ = pack(instant, offset(), get_kind());
         return *this;
     }
 
-    static inline date_time now_from_utc()
+    template<class rep, class period>
+    inline date_time& operator -= (const std::chrono::duration<rep, period>& duration)
     {
-        auto now_time = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+        return (*this) += -duration;
+    }
 
-        date_time date;
-        date.from_utc(now_time);
+    template<class rep, class period>
+    inline date_time operator + (const std::chrono::duration<rep, period>& duration) const
+    {
+        date_time result(*this);
+        result += duration;
+        return result;
+    }
 
+    template<class rep, class period>
+    inline date_time operator - (const std::chrono::duration<rep, period>& duration) const
+    {
+        date_time result(*this);
+        result -= duration;
+        return result;
+    }
+
+    inline std::chrono::milliseconds operator - (const date_time& other) const
+    {
+        return std::chrono::milliseconds(time_since_epoch() - other.time_since_epoch());
+    }
+
+    static inline date_time now_from_utc()
+    {
+        date_time date;
+        date.rep_ = pack(now_milliseconds(), 0, kind::offset_date_time);
         return date;
     }
 
@@ -185,753 +290,5344 @@ public:
         return date;
     }
 
-    inline void accept(std::ostream& stream)
+    static inline bool is_valid_date(int32_t year, int32_t month, int32_t day)
     {
-      char offset_sign = (hour_offset_ > 0) ? ('+') : ('-');
+        static const int32_t days_in_month[] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+        if(year < 0 || 9999 < year || month < 1 || 12 < month || day < 1)
+        {
+            return false;
+        }
 
-      stream << year_ << "-" << month_ << "-" << day_ << "T";
-      stream << hour_ << ":" << minute_ << ":" << second_;
-      stream << offset_sign;
-      stream << std::setw(2) << std::setfill('0') << std::abs(hour_offset_) << ":";
-      stream << std::setw(2) << std::setfill('0') << std::abs(hour_offset_);
+        bool leap = (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+        return day <= days_in_month[month - 1] + ((month == 2 && leap) ? (1) : (0));
     }
 
-private:
-    inline void update_current_time()
+    // Writes the RFC 3339 form TOML uses and returns its length; 32 bytes suffice.
+    inline size_t format(char* buffer) const
     {
-      tm t;
-      t.tm_year = year_ -1900;
-      t.tm_mon = month_;
-      t.tm_mday = day_;
-      t.tm_hour = hour_;
-      t.tm_min = minute_;
-      t.tm_sec = second_;
+        char* position = buffer;
+        int64_t wall_clock = local_milliseconds();
+        kind date_kind = get_kind();
+
+        if(date_kind != kind::local_time)
+        {
+            int32_t year, month, day;
+            civil_from_days(floor_div(wall_clock, milliseconds_per_day), year, month, day);
+            position = write_digits(position, year, 4);
+            *(position++) = '-';
+            position = write_digits(position, month, 2);
+            *(position++) = '-';
+            position = write_digits(position, day, 2);
+
+            if(date_kind == kind::local_date)
+            {
+                return position - buffer;
+            }
+            *(position++) = 'T';
+        }
+
+        int64_t time = floor_mod(wall_clock, milliseconds_per_day);
+        position = write_digits(position, static_cast<int32_t>(time / 3600000), 2);
+        *(position++) = ':';
+        position = write_digits(position, static_cast<int32_t>(time / 60000 % 60), 2);
+        *(position++) = ':';
+        position = write_digits(position, static_cast<int32_t>(time / 1000 % 60), 2);
+        if(time % 1000 != 0)
+        {
+            *(position++) = '.';
+            position = write_digits(position, static_cast<int32_t>(time % 1000), 3);
+        }
+
+        if(date_kind == kind::offset_date_time)
+        {
+            int32_t offset_minutes = offset();
+            if(offset_minutes == 0)
+            {
+                *(position++) = 'Z';
+            }
+            else
+            {
+                *(position++) = (offset_minutes > 0) ? ('+') : ('-');
+                offset_minutes = std::abs(offset_minutes);
+                position = write_digits(position, offset_minutes / 60, 2);
+                *(position++) = ':';
+                position = write_digits(position, offset_minutes % 60, 2);
+            }
+        }
+
+        return position - buffer;
+    }
 
-      current_time_ = std::mktime(&t) - hour_offset_ * 3600 - minute_offset_ * 60;
+    inline void accept(std::ostream& stream) const
+    {
+      char buffer[32];
+      stream.write(buffer, format(buffer));
     }
 
 private:
-    inline void from_utc(const tm& t)
+    static const int64_t milliseconds_per_day = 86400000;
+    static const int64_t instant_bias = int64_t(1) << 49;
+    static const int32_t offset_bias = 2048;
+
+    static constexpr uint64_t pack(int64_t instant, int32_t offset_minutes, kind date_kind)
     {
-        year_ = t.tm_year + 1900;
-        month_ = t.tm_mon;
-        day_ = t.tm_mday;
-        hour_ = t.tm_hour;
-        minute_ = t.tm_min;
-        second_ = t.tm_sec;
+        return (static_cast<uint64_t>(instant + instant_bias) << 14) |
+               (static_cast<uint64_t>(offset_minutes + offset_bias) << 2) |
+               static_cast<uint64_t>(date_kind);
     }
 
-    inline void from_local(const tm& t)
+    inline int64_t local_milliseconds() const
     {
-        year_ = t.tm_year + 1900;
-        month_ = t.tm_mon;
-        day_ = t.tm_mday;
-        hour_ = t.tm_hour;
-        minute_ = t.tm_min;
-        second_ = t.tm_sec;
+        return time_since_epoch() + static_cast<int64_t>(offset()) * 60000;
+    }
 
-        char buf[16];
-        std::strftime(buf, 16, "%z", &t);
+    inline void set_fields(kind date_kind, int64_t days, int64_t time, int32_t offset_minutes)
+    {
+        if(date_kind != kind::offset_date_time)
+        {
+            offset_minutes = 0;
+        }
 
-        int offset = std::stoi(buf);
-        hour_offset_ = offset / 100;
-        minute_offset_ = offset % 100;
+        if(date_kind == kind::local_time)
+        {
+            days = 0;
+        }
+        else if(date_kind == kind::local_date)
+        {
+            time = 0;
+        }
+
+        rep_ = pack(days * milliseconds_per_day + time - static_cast<int64_t>(offset_minutes) * 60000, offset_minutes, date_kind);
     }
-private:
-    uint32_t year_;
-    uint32_t month_;
-    uint32_t day_;
-    uint32_t hour_;
-    uint32_t minute_;
-    uint32_t second_;
-    int32_t hour_offset_;
-    int32_t minute_offset_;
-    time_t current_time_;
-};
 
-static inline std::ostream& operator << (std::ostream& stream, date_time& date)
-{
-  date.accept(stream);
-  return stream;
-}
+    static inline int64_t time_of_day(int32_t hour, int32_t minute, int32_t second, int32_t millisecond)
+    {
+        return ((static_cast<int64_t>(hour) * 60 + minute) * 60 + second) * 1000 + millisecond;
+    }
 
-class base
-{
-public:
-    enum class data_type
+    static inline int64_t now_milliseconds()
     {
-        integer,
-        floaing,
-        string,
-        boolean,
-        date,
-        array,
-        table 
-    };
+        auto now = std::chrono::system_clock::now().time_since_epoch();
+        return std::chrono::duration_cast<std::chrono::milliseconds>(now).count();
+    }
 
-    base(data_type type) : type_(type)
-    {}
+    static inline int64_t floor_div(int64_t value, int64_t divisor)
+    {
+        return (value >= 0) ? (value / divisor) : ((value - divisor + 1) / divisor);
+    }
 
-    virtual ~base() {}
+    static inline int64_t floor_mod(int64_t value, int64_t divisor)
+    {
+        return value - floor_div(value, divisor) * divisor;
+    }
 
-    inline data_type get_type() const
+    // Howard Hinnant's days_from_civil / civil_from_days.
+    static inline int64_t days_from_civil(int64_t year, int32_t month, int32_t day)
     {
-        return type_;
+        year -= (month <= 2) ? (1) : (0);
+        int64_t era = ((year >= 0) ? (year) : (year - 399)) / 400;
+        int64_t year_of_era = year - era * 400;
+        int64_t day_of_year = (153 * ((month > 2) ? (month - 3) : (month + 9)) + 2) / 5 + day - 1;
+        int64_t day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+        return era * 146097 + day_of_era - 719468;
     }
 
-    template<class type>
-    inline bool is() const
+    static inline void civil_from_days(int64_t days, int32_t& year, int32_t& month, int32_t& day)
     {
-        return false;
+        days += 719468;
+        int64_t era = ((days >= 0) ? (days) : (days - 146096)) / 146097;
+        int64_t day_of_era = days - era * 146097;
+        int64_t year_of_era = (day_of_era - day_of_era / 1460 + day_of_era / 36524 - day_of_era / 146096) / 365;
+        int64_t day_of_year = day_of_era - (365 * year_of_era + year_of_era / 4 - year_of_era / 100);
+        int64_t month_index = (5 * day_of_year + 2) / 153;
+
+        day = static_cast<int32_t>(day_of_year - (153 * month_index + 2) / 5 + 1);
+        month = static_cast<int32_t>((month_index < 10) ? (month_index + 3) : (month_index - 9));
+        year = static_cast<int32_t>(year_of_era + era * 400 + ((month <= 2) ? (1) : (0)));
+    }
+
+    static inline char* write_digits(char* position, int32_t value, int width)
+    {
+        for(int i = width - 1; i >= 0; --i)
+        {
+            position[i] = static_cast<char>('0' + value % 10);
+            value /= 10;
+        }
+
+        return position + width;
     }
 
-    virtual void accept(std::ostream& stream) = 0;
 private:
-    data_type type_;
+    uint64_t rep_;
 };
 
-static inline std::ostream& operator << (std::ostream& stream, base& base_data)
+static inline std::ostream& operator << (std::ostream& stream, const date_time& date)
 {
-  base_data.accept(stream);
+  date.accept(stream);
   return stream;
 }
 
-template<class value_data, base::data_type type>
-class value : public base
+// Writes the decimal form of a double that reads back as the same value into a
+// caller supplied buffer, without iostreams or locales. This is Grisu2
+// (Loitsch, "Printing Floating-Point Numbers Quickly and Accurately with
+// Integers", 2010) as in Milo Yip's and nlohmann's implementations: the output
+// always round-trips and is the shortest one except in rare cases where it is
+// a digit longer.
+class float_formatter
 {
 public:
-    using value_type = value_data;
+    static const size_t buffer_size = 32;
 
-    value() : base(type)
-    {}
+    // Writes a TOML float (always with a '.' or an exponent) and returns its length.
+    static inline size_t format(double value, char* buffer)
+    {
+        char* position = buffer;
+        if(std::isnan(value))
+        {
+            std::memcpy(position, "nan", 3);
+            return 3;
+        }
 
-    value(const value_data& data) : base(type), data_(data)
-    {}
+        if(std::signbit(value))
+        {
+            value = -value;
+            *(position++) = '-';
+        }
 
-    value(const value<value_data, type>& other) : base(type), data_(other.data_)
-    {}
+        if(std::isinf(value))
+        {
+            std::memcpy(position, "inf", 3);
+            return position + 3 - buffer;
+        }
 
-    value(value<value_data, type>&& other) : base(type), data_(std::move(other.data_))
-    {}
+        if(value == 0)
+        {
+            std::memcpy(position, "0.0", 3);
+            return position + 3 - buffer;
+        }
 
-    virtual ~value() {}
+        int length = 0;
+        int decimal_exponent = 0;
+        grisu2(position, length, decimal_exponent, value);
 
-    inline value_data& get()
-    {
-        return data_;
+        return format_buffer(position, length, decimal_exponent, -4, 15) - buffer;
     }
 
-    inline const value_data& get() const
+private:
+    struct diyfp
     {
-        return data_;
-    }
+        diyfp(uint64_t significand, int exponent) : f(significand), e(exponent)
+        {}
 
-    inline value<value_data, type>& operator = (const value_data& data)
-    {
-        data_ = data;
-        return *this;
-    }
+        static inline diyfp sub(const diyfp& x, const diyfp& y)
+        {
+            return diyfp(x.f - y.f, x.e);
+        }
 
-    virtual inline void accept(std::ostream&) override
-    {}
+        static inline diyfp mul(const diyfp& x, const diyfp& y)
+        {
+            uint64_t u_lo = x.f & 0xFFFFFFFFu;
+            uint64_t u_hi = x.f >> 32;
+            uint64_t v_lo = y.f & 0xFFFFFFFFu;
+            uint64_t v_hi = y.f >> 32;
 
-protected:
-    value_data data_;
-};
+            uint64_t p0 = u_lo * v_lo;
+            uint64_t p1 = u_lo * v_hi;
+            uint64_t p2 = u_hi * v_lo;
+            uint64_t p3 = u_hi * v_hi;
 
-template<>
-inline void value<int, base::data_type::integer>::accept(std::ostream& stream)
-{
-  stream << data_;
-}
+            uint64_t q = (p0 >> 32) + (p1 & 0xFFFFFFFFu) + (p2 & 0xFFFFFFFFu);
+            q += uint64_t(1) << 31;
 
-template<>
-inline void value<float, base::data_type::floaing>::accept(std::ostream& stream)
-{
-  stream << data_;
-}
+            return diyfp(p3 + (p2 >> 32) + (p1 >> 32) + (q >> 32), x.e + y.e + 64);
+        }
 
-template<>
-inline void value<std::string, base::data_type::string>::accept(std::ostream& stream)
-{
-  stream << data_;
-}
+        static inline diyfp normalize(diyfp x)
+        {
+            while((x.f >> 63) == 0)
+            {
+                x.f <<= 1;
+                --x.e;
+            }
 
-template<>
-inline void value<bool, base::data_type::boolean>::accept(std::ostream& stream)
-{
-  std::string bool_str = (data_) ? ("true") : ("false");
-  stream << bool_str;
-}
+            return x;
+        }
 
-template<>
-inline void value<date_time, base::data_type::date>::accept(std::ostream& stream)
-{
-  stream << data_;
-}
+        static inline diyfp normalize_to(const diyfp& x, int target_exponent)
+        {
+            return diyfp(x.f << (x.e - target_exponent), target_exponent);
+        }
 
-using int_value = value<int, base::data_type::integer>;
-using float_value = value<float, base::data_type::floaing>;
-using string_value = value<std::string, base::data_type::string>;
-using bool_value = value<bool, base::data_type::boolean>;
-using date_time_value = value<date_time, base::data_type::date>;
+        uint64_t f;
+        int e;
+    };
 
-template<>
-inline bool base::is<int>() const
-{
-    return type_ == data_type::integer;
-}
+    struct cached_power
+    {
+        uint64_t f;
+        int e;
+        int k;
+    };
 
-template<>
-inline bool base::is<float>() const
-{
-    return type_ == data_type::floaing;
-}
+    static const int alpha = -60;
+    static const int gamma = -32;
 
-template<>
-inline bool base::is<std::string>() const
-{
-    return type_ == data_type::string;
-}
+    // Normalized 10^k for k = -348, -340, ..., 340.
+    static inline cached_power get_cached_power_for_binary_exponent(int e)
+    {
+        static const cached_power cached_powers[] =
+        {
+            { 0xFA8FD5A0081C0288, -1220, -348 },
+            { 0xBAAEE17FA23EBF76, -1193, -340 },
+            { 0x8B16FB203055AC76, -1166, -332 },
+            { 0xCF42894A5DCE35EA, -1140, -324 },
+            { 0x9A6BB0AA55653B2D, -1113, -316 },
+            { 0xE61ACF033D1A45DF, -1087, -308 },
+            { 0xAB70FE17C79AC6CA, -1060, -300 },
+            { 0xFF77B1FCBEBCDC4F, -1034, -292 },
+            { 0xBE5691EF416BD60C, -1007, -284 },
+            { 0x8DD01FAD907FFC3C,  -980, -276 },
+            { 0xD3515C2831559A83,  -954, -268 },
+            { 0x9D71AC8FADA6C9B5,  -927, -260 },
+            { 0xEA9C227723EE8BCB,  -901, -252 },
+            { 0xAECC49914078536D,  -874, -244 },
+            { 0x823C12795DB6CE57,  -847, -236 },
+            { 0xC21094364DFB5637,  -821, -228 },
+            { 0x9096EA6F3848984F,  -794, -220 },
+            { 0xD77485CB25823AC7,  -768, -212 },
+            { 0xA086CFCD97BF97F4,  -741, -204 },
+            { 0xEF340A98172AACE5,  -715, -196 },
+            { 0xB23867FB2A35B28E,  -688, -188 },
+            { 0x84C8D4DFD2C63F3B,  -661, -180 },
+            { 0xC5DD44271AD3CDBA,  -635, -172 },
+            { 0x936B9FCEBB25C996,  -608, -164 },
+            { 0xDBAC6C247D62A584,  -582, -156 },
+            { 0xA3AB66580D5FDAF6,  -555, -148 },
+            { 0xF3E2F893DEC3F126,  -529, -140 },
+            { 0xB5B5ADA8AAFF80B8,  -502, -132 },
+            { 0x87625F056C7C4A8B,  -475, -124 },
+            { 0xC9BCFF6034C13053,  -449, -116 },
+            { 0x964E858C91BA2655,  -422, -108 },
+            { 0xDFF9772470297EBD,  -396, -100 },
+            { 0xA6DFBD9FB8E5B88F,  -369,  -92 },
+            { 0xF8A95FCF88747D94,  -343,  -84 },
+            { 0xB94470938FA89BCF,  -316,  -76 },
+            { 0x8A08F0F8BF0F156B,  -289,  -68 },
+            { 0xCDB02555653131B6,  -263,  -60 },
+            { 0x993FE2C6D07B7FAC,  -236,  -52 },
+            { 0xE45C10C42A2B3B06,  -210,  -44 },
+            { 0xAA242499697392D3,  -183,  -36 },
+            { 0xFD87B5F28300CA0E,  -157,  -28 },
+            { 0xBCE5086492111AEB,  -130,  -20 },
+            { 0x8CBCCC096F5088CC,  -103,  -12 },
+            { 0xD1B71758E219652C,   -77,   -4 },
+            { 0x9C40000000000000,   -50,    4 },
+            { 0xE8D4A51000000000,   -24,   12 },
+            { 0xAD78EBC5AC620000,     3,   20 },
+            { 0x813F3978F8940984,    30,   28 },
+            { 0xC097CE7BC90715B3,    56,   36 },
+            { 0x8F7E32CE7BEA5C70,    83,   44 },
+            { 0xD5D238A4ABE98068,   109,   52 },
+            { 0x9F4F2726179A2245,   136,   60 },
+            { 0xED63A231D4C4FB27,   162,   68 },
+            { 0xB0DE65388CC8ADA8,   189,   76 },
+            { 0x83C7088E1AAB65DB,   216,   84 },
+            { 0xC45D1DF942711D9A,   242,   92 },
+            { 0x924D692CA61BE758,   269,  100 },
+            { 0xDA01EE641A708DEA,   295,  108 },
+            { 0xA26DA3999AEF774A,   322,  116 },
+            { 0xF209787BB47D6B85,   348,  124 },
+            { 0xB454E4A179DD1877,   375,  132 },
+            { 0x865B86925B9BC5C2,   402,  140 },
+            { 0xC83553C5C8965D3D,   428,  148 },
+            { 0x952AB45CFA97A0B3,   455,  156 },
+            { 0xDE469FBD99A05FE3,   481,  164 },
+            { 0xA59BC234DB398C25,   508,  172 },
+            { 0xF6C69A72A3989F5C,   534,  180 },
+            { 0xB7DCBF5354E9BECE,   561,  188 },
+            { 0x88FCF317F22241E2,   588,  196 },
+            { 0xCC20CE9BD35C78A5,   614,  204 },
+            { 0x98165AF37B2153DF,   641,  212 },
+            { 0xE2A0B5DC971F303A,   667,  220 },
+            { 0xA8D9D1535CE3B396,   694,  228 },
+            { 0xFB9B7CD9A4A7443C,   720,  236 },
+            { 0xBB764C4CA7A44410,   747,  244 },
+            { 0x8BAB8EEFB6409C1A,   774,  252 },
+            { 0xD01FEF10A657842C,   800,  260 },
+            { 0x9B10A4E5E9913129,   827,  268 },
+            { 0xE7109BFBA19C0C9D,   853,  276 },
+            { 0xAC2820D9623BF429,   880,  284 },
+            { 0x80444B5E7AA7CF85,   907,  292 },
+            { 0xBF21E44003ACDD2D,   933,  300 },
+            { 0x8E679C2F5E44FF8F,   960,  308 },
+            { 0xD433179D9C8CB841,   986,  316 },
+            { 0x9E19DB92B4E31BA9,  1013,  324 },
+            { 0xEB96BF6EBADF77D9,  1039,  332 },
+            { 0xAF87023B9BF0EE6B,  1066,  340 }
+        };
 
-template<>
-inline bool base::is<bool>() const
-{
-    return type_ == data_type::boolean;
-}
+        int f = alpha - e - 1;
+        int k = (f * 78913) / (1 << 18) + ((f > 0) ? (1) : (0));
+        int index = (348 + k + 7) / 8;
 
-template<>
-inline bool base::is<date_time>() const
-{
-    return type_ == data_type::date;
-}
+        assert(0 <= index && static_cast<size_t>(index) < sizeof(cached_powers) / sizeof(cached_powers[0]));
+        return cached_powers[index];
+    }
 
-class array;
-template<>
-inline bool base::is<array>() const
-{
-    return type_ == data_type::array;
-}
+    static inline int find_largest_pow10(uint32_t n, uint32_t& pow10)
+    {
+        int digits = 10;
+        pow10 = 1000000000;
+        while(digits > 1 && n < pow10)
+        {
+            pow10 /= 10;
+            --digits;
+        }
 
-class table;
-template<>
-inline bool base::is<table>() const
-{
-    return type_ == data_type::table;
-}
+        return digits;
+    }
 
-class array : public value<std::vector<std::shared_ptr<base>>, base::data_type::array>
-{
-public:
-    using base_type = value<std::vector<std::shared_ptr<base>>, base::data_type::array>;
-    using container_type = typename base_type::value_type;
-    using base_value_type = typename container_type::value_type::element_type;
+    static inline void grisu2_round(char* buffer, int length, uint64_t dist, uint64_t delta, uint64_t rest, uint64_t ten_k)
+    {
+        while(rest < dist && delta - rest >= ten_k && (rest + ten_k < dist || dist - rest > rest + ten_k - dist))
+        {
+            --buffer[length - 1];
+            rest += ten_k;
+        }
+    }
 
-    using iterator = typename container_type::iterator;
-    using const_iterator = typename container_type::const_iterator;
+    static inline void grisu2_digit_gen(char* buffer, int& length, int& decimal_exponent, diyfp m_minus, diyfp w, diyfp m_plus)
+    {
+        uint64_t delta = diyfp::sub(m_plus, m_minus).f;
+        uint64_t dist = diyfp::sub(m_plus, w).f;
 
-    array() = default;
-    
-    array(const std::vector<std::shared_ptr<base>>& data) : base_type(data) 
-    {}
+        diyfp one(uint64_t(1) << -m_plus.e, m_plus.e);
+
+        uint32_t p1 = static_cast<uint32_t>(m_plus.f >> -one.e);
+        uint64_t p2 = m_plus.f & (one.f - 1);
+
+        uint32_t pow10;
+        int n = find_largest_pow10(p1, pow10);
+        while(n > 0)
+        {
+            uint32_t digit = p1 / pow10;
+            p1 %= pow10;
+            buffer[length++] = static_cast<char>('0' + digit);
+            --n;
+
+            uint64_t rest = (static_cast<uint64_t>(p1) << -one.e) + p2;
+            if(rest <= delta)
+            {
+                decimal_exponent += n;
+                grisu2_round(buffer, length, dist, delta, rest, static_cast<uint64_t>(pow10) << -one.e);
+                return;
+            }
+
+            pow10 /= 10;
+        }
+
+        int m = 0;
+        while(true)
+        {
+            p2 *= 10;
+            buffer[length++] = static_cast<char>('0' + (p2 >> -one.e));
+            p2 &= one.f - 1;
+            ++m;
+
+            delta *= 10;
+            dist *= 10;
+            if(p2 <= delta)
+            {
+                break;
+            }
+        }
+
+        decimal_exponent -= m;
+        grisu2_round(buffer, length, dist, delta, p2, one.f);
+    }
+
+    static inline void grisu2(char* buffer, int& length, int& decimal_exponent, double value)
+    {
+        uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+
+        const uint64_t hidden_bit = uint64_t(1) << 52;
+        uint64_t significand = bits & (hidden_bit - 1);
+        int biased_exponent = static_cast<int>(bits >> 52);
+
+        diyfp v = (biased_exponent == 0) ? (diyfp(significand, 1 - 1075)) : (diyfp(significand + hidden_bit, biased_exponent - 1075));
+        bool lower_boundary_is_closer = (significand == 0 && biased_exponent > 1);
+
+        diyfp m_plus(2 * v.f + 1, v.e - 1);
+        diyfp m_minus = (lower_boundary_is_closer) ? (diyfp(4 * v.f - 1, v.e - 2)) : (diyfp(2 * v.f - 1, v.e - 1));
+
+        diyfp w_plus = diyfp::normalize(m_plus);
+        diyfp w_minus = diyfp::normalize_to(m_minus, w_plus.e);
+        diyfp w = diyfp::normalize(v);
+
+        cached_power cached = get_cached_power_for_binary_exponent(w_plus.e);
+        diyfp c_minus_k(cached.f, cached.e);
+
+        diyfp scaled = diyfp::mul(w, c_minus_k);
+        diyfp scaled_minus = diyfp::mul(w_minus, c_minus_k);
+        diyfp scaled_plus = diyfp::mul(w_plus, c_minus_k);
+
+        decimal_exponent = -cached.k;
+        grisu2_digit_gen(buffer, length, decimal_exponent,
+                         diyfp(scaled_minus.f + 1, scaled_minus.e), scaled, diyfp(scaled_plus.f - 1, scaled_plus.e));
+    }
+
+    // The digits in buffer stand for digits * 10^decimal_exponent.
+    static inline char* format_buffer(char* buffer, int k, int decimal_exponent, int min_exponent, int max_exponent)
+    {
+        int n = k + decimal_exponent;
+
+        if(k <= n && n <= max_exponent)
+        {
+            std::memset(buffer + k, '0', n - k);
+            buffer[n] = '.';
+            buffer[n + 1] = '0';
+            return buffer + n + 2;
+        }
+
+        if(0 < n && n <= max_exponent)
+        {
+            std::memmove(buffer + n + 1, buffer + n, k - n);
+            buffer[n] = '.';
+            return buffer + k + 1;
+        }
+
+        if(min_exponent < n && n <= 0)
+        {
+            std::memmove(buffer + 2 - n, buffer, k);
+            buffer[0] = '0';
+            buffer[1] = '.';
+            std::memset(buffer + 2, '0', -n);
+            return buffer + 2 - n + k;
+        }
+
+        if(k == 1)
+        {
+            buffer += 1;
+        }
+        else
+        {
+            std::memmove(buffer + 2, buffer + 1, k - 1);
+            buffer[1] = '.';
+            buffer += k + 1;
+        }
+
+        int exponent = n - 1;
+        *(buffer++) = 'e';
+        *(buffer++) = (exponent < 0) ? ('-') : ('+');
+        exponent = std::abs(exponent);
+
+        if(exponent >= 100)
+        {
+            *(buffer++) = static_cast<char>('0' + exponent / 100);
+            exponent %= 100;
+            *(buffer++) = static_cast<char>('0' + exponent / 10);
+        }
+        else if(exponent >= 10)
+        {
+            *(buffer++) = static_cast<char>('0' + exponent / 10);
+        }
+        *(buffer++) = static_cast<char>('0' + exponent % 10);
 
-    array(const array& other) : base_type(other)
+        return buffer;
+    }
+};
+
+// The hash of an array or table, kept until a change below the container
+// is passed up to it. Loads and stores are atomic, so const comparisons
+// of one tree may run on several threads at once.
+class hash_cache
+{
+public:
+    hash_cache() : value_(0), valid_(false)
     {}
 
-    array(array&& other) : base_type(std::move(other))
+    // A copy starts empty, as it belongs to another container.
+    hash_cache(const hash_cache&) : value_(0), valid_(false)
     {}
 
-    template<class value_data>
-    inline void add(const value_data& data)
+    inline hash_cache& operator = (const hash_cache&)
     {
-        std::shared_ptr<value_data> data_ptr = std::make_shared<value_data>(data);
-        data_.emplace_back(std::static_pointer_cast<base>(data_ptr));
+        drop();
+        return *this;
     }
 
-    template<class value_data>
-    inline void add(const std::string& key, std::shared_ptr<value_data> value)
+    inline bool valid() const
     {
-        data_.emplace_back(std::static_pointer_cast<base>(value));
+        return valid_.load(std::memory_order_acquire);
     }
 
-    inline void add(const int& data)
+    inline bool load(uint64_t& value) const
     {
-        add(int_value(data));
+        if(!valid())
+        {
+            return false;
+        }
+
+        value = value_.load(std::memory_order_relaxed);
+        return true;
     }
 
-    inline void add(const float& data)
+    inline void store(uint64_t value) const
     {
-        add(float_value(data));
+        value_.store(value, std::memory_order_relaxed);
+        valid_.store(true, std::memory_order_release);
     }
 
-    inline void add(const char* data)
+    // False if nothing was cached.
+    inline bool drop()
     {
-        add(std::string(data));
+        if(!valid_.load(std::memory_order_relaxed))
+        {
+            return false;
+        }
+
+        valid_.store(false, std::memory_order_relaxed);
+        return true;
     }
 
-    inline void add(const std::string& data)
+private:
+    mutable std::atomic<uint64_t> value_;
+    mutable std::atomic<bool> valid_;
+};
+
+// Approximate memory held by a tree, for metrics. Sizes follow the usual
+// standard library layouts and leave out allocator overhead.
+struct memory_breakdown
+{
+    // A make_shared control block: the vtable pointer and two counts.
+    static const size_t control_block_size = sizeof(void*) + 2 * sizeof(long);
+
+    memory_breakdown() : nodes(0), keys(0), strings(0), containers(0)
+    {}
+
+    inline size_t total() const
     {
-        add(string_value(data));
+        return nodes + keys + strings + containers;
     }
 
-    inline void add(const bool& data)
+    inline memory_breakdown& operator += (const memory_breakdown& other)
     {
-        add(bool_value(data));
+        nodes += other.nodes;
+        keys += other.keys;
+        strings += other.strings;
+        containers += other.containers;
+        return *this;
     }
 
-    inline void add(const date_time& data)
+    // What a string keeps outside of itself; short strings keep nothing.
+    inline static size_t heap_size(const std::string& str)
     {
-        add(date_time_value(data));
+        return (str.capacity() > std::string().capacity()) ? (str.capacity() + 1) : (0);
     }
 
-    inline size_t size() const
+    size_t nodes;       // value objects and their control blocks
+    size_t keys;        // table key text
+    size_t strings;     // string value text
+    size_t containers;  // array storage, hash buckets and hash nodes
+};
+
+class base
+{
+public:
+    enum class data_type
+    {
+        integer,
+        floaing,
+        string,
+        boolean,
+        date,
+        array,
+        table 
+    };
+
+    base(data_type type) : type_(type), parent_(nullptr)
+    {}
+
+    virtual ~base() {}
+
+    inline data_type get_type() const
     {
-        return data_.size();
+        return type_;
     }
 
-    template<class value_data>
-    inline std::shared_ptr<value_data> get_at_as(int index)
+    template<class type>
+    inline bool is() const
     {
-        std::shared_ptr<base> base_type_value = operator[](index);
-        return std::dynamic_pointer_cast<value_data>(base_type_value);
+        return false;
     }
 
-    template<class value_data>
-    inline std::vector<std::shared_ptr<value_data>> get_array_as()
+    virtual void accept(std::ostream& stream) const = 0;
+
+    // Values shared by several parents are counted once.
+    inline memory_breakdown memory_usage() const
     {
-        std::vector<std::shared_ptr<value_data>> result(data_.size());
+        memory_breakdown usage;
+        std::unordered_set<const base*> shared;
+        add_memory_usage(usage, shared);
+        return usage;
+    }
 
-        std::transform(data_.begin(), data_.end(), result.begin(),
-                [&](std::shared_ptr<base> data){ return std::dynamic_pointer_cast<value_data>(data); });
+    virtual void add_memory_usage(memory_breakdown& usage, std::unordered_set<const base*>& shared) const = 0;
 
-        return result;
+protected:
+    // Each value points to the array or table it was added to, if that is
+    // the only one holding it; a change to the value is passed up through
+    // these pointers, and every container on the way drops its cached hash.
+    inline void changed();
+
+    inline void adopt(base& child)
+    {
+        if(child.parent_ == nullptr)
+        {
+            child.parent_ = this;
+        }
     }
 
-    inline std::shared_ptr<base> operator[] (int index)
+    inline void release(base& child)
     {
-        return data_[index];
+        if(child.parent_ == this)
+        {
+            child.parent_ = nullptr;
+        }
     }
 
-    inline iterator begin()
+    inline void take_over(base& child, const base& previous)
     {
-        return data_.begin();
+        if(child.parent_ == &previous)
+        {
+            child.parent_ = this;
+        }
     }
 
-    inline iterator end()
+    // True if changes to child reach this container, and child's own hash,
+    // if it has one, is cached; only then may this container cache its own.
+    inline bool tracks(const base& child) const;
+
+    // Copy-on-write: a child that another container owns is copied, and the
+    // copy put in its place, before this one hands it out for changing.
+    inline void own(std::shared_ptr<base>& child);
+
+    inline static void add_child_memory_usage(const std::shared_ptr<base>& child, memory_breakdown& usage, std::unordered_set<const base*>& shared)
     {
-        return data_.end();
+        if(child.use_count() > 1 && !shared.insert(child.get()).second)
+        {
+            return;
+        }
+
+        usage.nodes += memory_breakdown::control_block_size;
+        child->add_memory_usage(usage, shared);
     }
 
-    inline const_iterator begin() const
+private:
+    inline bool drop_cached_hash();
+
+    data_type type_;
+    base* parent_;
+};
+
+static inline std::ostream& operator << (std::ostream& stream, const base& base_data)
+{
+  base_data.accept(stream);
+  return stream;
+}
+
+template<class value_data, base::data_type type>
+class value : public base
+{
+public:
+    using value_type = value_data;
+
+    value() : base(type)
+    {}
+
+    value(const value_data& data) : base(type), data_(data)
+    {}
+
+    value(value_data&& data) : base(type), data_(std::move(data))
+    {}
+
+    value(const value<value_data, type>& other) : base(type), data_(other.data_)
+    {}
+
+    value(value<value_data, type>&& other) : base(type), data_(std::move(other.data_))
+    {}
+
+    virtual ~value() {}
+
+    inline value_data& get()
     {
-        return data_.begin();
+        changed();
+        return data_;
     }
 
-    inline const_iterator end() const
+    inline const value_data& get() const
     {
-        return data_.end();
+        return data_;
+    }
+
+    inline value<value_data, type>& operator = (const value_data& data)
+    {
+        changed();
+        data_ = data;
+        return *this;
+    }
+
+    inline value<value_data, type>& operator = (const value<value_data, type>& other)
+    {
+        changed();
+        data_ = other.data_;
+        return *this;
+    }
+
+    inline value<value_data, type>& operator = (value<value_data, type>&& other)
+    {
+        changed();
+        data_ = std::move(other.data_);
+        return *this;
+    }
+
+    virtual inline void accept(std::ostream&) const override
+    {}
+
+    virtual inline void add_memory_usage(memory_breakdown& usage, std::unordered_set<const base*>&) const override
+    {
+        usage.nodes += sizeof(*this);
     }
 
-    virtual void accept(std::ostream& stream) override
-    {
-      stream << '[';
-      const_iterator iterator = begin();
-      while(iterator != end())
-      {
-        stream << *(*iterator);
-        iterator += 1;
-        if(iterator != end())
+protected:
+    value_data data_;
+};
+
+template<>
+inline void value<int64_t, base::data_type::integer>::accept(std::ostream& stream) const
+{
+  stream << data_;
+}
+
+template<>
+inline void value<double, base::data_type::floaing>::accept(std::ostream& stream) const
+{
+  char buffer[float_formatter::buffer_size];
+  stream.write(buffer, float_formatter::format(data_, buffer));
+}
+
+inline void append_quoted(std::string& output, const char* str, size_t size)
+{
+    static const char hex[] = "0123456789ABCDEF";
+
+    output += '"';
+    const char* unescaped = str;
+    const char* end = str + size;
+    for(const char* c = str; c != end; ++c)
+    {
+        unsigned char code = static_cast<unsigned char>(*c);
+        if(code >= 0x20 && code != '"' && code != '\\' && code != 0x7F)
+        {
+            continue;
+        }
+
+        output.append(unescaped, c);
+        unescaped = c + 1;
+        switch(code)
+        {
+        case '"': output += "\\\""; break;
+        case '\\': output += "\\\\"; break;
+        case '\b': output += "\\b"; break;
+        case '\t': output += "\\t"; break;
+        case '\n': output += "\\n"; break;
+        case '\f': output += "\\f"; break;
+        case '\r': output += "\\r"; break;
+        default:
+            output += "\\u00";
+            output += hex[code >> 4];
+            output += hex[code & 0x0F];
+            break;
+        }
+    }
+
+    output.append(unescaped, end);
+    output += '"';
+}
+
+inline void append_quoted(std::string& output, const std::string& str)
+{
+    append_quoted(output, str.data(), str.size());
+}
+
+// Keys that are not bare are written as basic strings.
+inline std::string format_key(const std::string& key)
+{
+    bool bare = !key.empty();
+    for(char c : key)
+    {
+        bare = bare && (('a' <= c && c <= 'z') || ('A' <= c && c <= 'Z') || ('0' <= c && c <= '9') || c == '_' || c == '-');
+    }
+
+    if(bare)
+    {
+        return key;
+    }
+
+    std::string quoted;
+    append_quoted(quoted, key);
+    return quoted;
+}
+
+inline void append_utf8(std::string& output, uint32_t code_point)
+{
+    if(code_point < 0x80)
+    {
+        output += static_cast<char>(code_point);
+    }
+    else if(code_point < 0x800)
+    {
+        output += static_cast<char>(0xC0 | (code_point >> 6));
+        output += static_cast<char>(0x80 | (code_point & 0x3F));
+    }
+    else if(code_point < 0x10000)
+    {
+        output += static_cast<char>(0xE0 | (code_point >> 12));
+        output += static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+        output += static_cast<char>(0x80 | (code_point & 0x3F));
+    }
+    else
+    {
+        output += static_cast<char>(0xF0 | (code_point >> 18));
+        output += static_cast<char>(0x80 | ((code_point >> 12) & 0x3F));
+        output += static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+        output += static_cast<char>(0x80 | (code_point & 0x3F));
+    }
+}
+
+// A string either owns its characters or is a view into a source buffer
+// (see parse::parse_view) that must outlive it. The non-const get() copies a
+// view into owned storage on first use; the const get() returns a copy and,
+// like data() and size(), leaves the value unchanged.
+template<>
+class value<std::string, base::data_type::string> : public base
+{
+public:
+    using value_type = std::string;
+
+    value() : base(data_type::string), view_data_(nullptr), view_size_(0)
+    {}
+
+    value(const std::string& data) : base(data_type::string), data_(data), view_data_(nullptr), view_size_(0)
+    {}
+
+    value(std::string&& data) : base(data_type::string), data_(std::move(data)), view_data_(nullptr), view_size_(0)
+    {}
+
+    value(const value<std::string, data_type::string>& other) :
+        base(data_type::string),
+        data_(other.data_),
+        view_data_(other.view_data_),
+        view_size_(other.view_size_)
+    {}
+
+    value(value<std::string, data_type::string>&& other) :
+        base(data_type::string),
+        data_(std::move(other.data_)),
+        view_data_(other.view_data_),
+        view_size_(other.view_size_)
+    {}
+
+    virtual ~value() {}
+
+    inline static value<std::string, data_type::string> view(const char* data, size_t size)
+    {
+        value<std::string, data_type::string> result;
+        result.view_data_ = data;
+        result.view_size_ = size;
+        return result;
+    }
+
+    inline bool is_view() const
+    {
+        return view_data_ != nullptr;
+    }
+
+    inline const char* data() const
+    {
+        return (view_data_ != nullptr) ? (view_data_) : (data_.data());
+    }
+
+    inline size_t size() const
+    {
+        return (view_data_ != nullptr) ? (view_size_) : (data_.size());
+    }
+
+    inline std::string& get()
+    {
+        changed();
+        own();
+        return data_;
+    }
+
+    inline std::string get() const
+    {
+        return std::string(data(), size());
+    }
+
+    inline value<std::string, data_type::string>& operator = (const std::string& data)
+    {
+        changed();
+        data_ = data;
+        view_data_ = nullptr;
+        return *this;
+    }
+
+    inline value<std::string, data_type::string>& operator = (const value<std::string, data_type::string>& other)
+    {
+        changed();
+        data_ = other.data_;
+        view_data_ = other.view_data_;
+        view_size_ = other.view_size_;
+        return *this;
+    }
+
+    inline value<std::string, data_type::string>& operator = (value<std::string, data_type::string>&& other)
+    {
+        changed();
+        data_ = std::move(other.data_);
+        view_data_ = other.view_data_;
+        view_size_ = other.view_size_;
+        return *this;
+    }
+
+    virtual inline void accept(std::ostream& stream) const override
+    {
+      std::string quoted;
+      append_quoted(quoted, data(), size());
+      stream << quoted;
+    }
+
+    virtual inline void add_memory_usage(memory_breakdown& usage, std::unordered_set<const base*>&) const override
+    {
+        usage.nodes += sizeof(*this);
+        usage.strings += (is_view()) ? (0) : (memory_breakdown::heap_size(data_));
+    }
+
+    inline void shrink_to_fit()
+    {
+        data_.shrink_to_fit();
+    }
+
+private:
+    inline void own()
+    {
+        if(view_data_ != nullptr)
+        {
+            data_.assign(view_data_, view_size_);
+            view_data_ = nullptr;
+        }
+    }
+
+    std::string data_;
+    const char* view_data_;
+    size_t view_size_;
+};
+
+template<>
+inline void value<bool, base::data_type::boolean>::accept(std::ostream& stream) const
+{
+  std::string bool_str = (data_) ? ("true") : ("false");
+  stream << bool_str;
+}
+
+template<>
+inline void value<date_time, base::data_type::date>::accept(std::ostream& stream) const
+{
+  stream << data_;
+}
+
+using int_value = value<int64_t, base::data_type::integer>;
+using float_value = value<double, base::data_type::floaing>;
+using string_value = value<std::string, base::data_type::string>;
+using bool_value = value<bool, base::data_type::boolean>;
+using date_time_value = value<date_time, base::data_type::date>;
+
+template<>
+inline bool base::is<int64_t>() const
+{
+    return type_ == data_type::integer;
+}
+
+template<>
+inline bool base::is<int>() const
+{
+    return type_ == data_type::integer;
+}
+
+template<>
+inline bool base::is<double>() const
+{
+    return type_ == data_type::floaing;
+}
+
+template<>
+inline bool base::is<float>() const
+{
+    return type_ == data_type::floaing;
+}
+
+template<>
+inline bool base::is<std::string>() const
+{
+    return type_ == data_type::string;
+}
+
+template<>
+inline bool base::is<bool>() const
+{
+    return type_ == data_type::boolean;
+}
+
+template<>
+inline bool base::is<date_time>() const
+{
+    return type_ == data_type::date;
+}
+
+class array;
+class string_pool;
+inline void release_children(std::vector<std::shared_ptr<base>>& pending);
+template<>
+inline bool base::is<array>() const
+{
+    return type_ == data_type::array;
+}
+
+class table;
+template<>
+inline bool base::is<table>() const
+{
+    return type_ == data_type::table;
+}
+
+template<class element_type>
+class span
+{
+public:
+    span() : data_(nullptr), size_(0)
+    {}
+
+    span(element_type* data, size_t size) : data_(data), size_(size)
+    {}
+
+    inline element_type* data() const
+    {
+        return data_;
+    }
+
+    inline size_t size() const
+    {
+        return size_;
+    }
+
+    inline bool empty() const
+    {
+        return size_ == 0;
+    }
+
+    inline element_type& operator[] (size_t index) const
+    {
+        return data_[index];
+    }
+
+    inline element_type* begin() const
+    {
+        return data_;
+    }
+
+    inline element_type* end() const
+    {
+        return data_ + size_;
+    }
+
+private:
+    element_type* data_;
+    size_t size_;
+};
+
+// Arrays whose elements are all integers or all floats keep them unboxed in a
+// contiguous vector, readable without copying through get_span_as(). Non-const
+// access that hands out element pointers (get(), begin(), operator[], ...)
+// first converts the array to the boxed form for good; const access leaves it
+// packed and hands out a new value for each packed element instead.
+class array : public value<std::vector<std::shared_ptr<base>>, base::data_type::array>
+{
+public:
+    using base_type = value<std::vector<std::shared_ptr<base>>, base::data_type::array>;
+    using container_type = typename base_type::value_type;
+    using base_value_type = typename container_type::value_type::element_type;
+
+    using iterator = typename container_type::const_iterator;
+
+    using integer_type = int_value::value_type;
+    using floating_type = float_value::value_type;
+
+    class const_iterator
+    {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = std::shared_ptr<base>;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const value_type*;
+        using reference = value_type;
+
+        const_iterator(const array* owner, size_t index) : owner_(owner), index_(index)
+        {}
+
+        inline value_type operator * () const
+        {
+            return owner_->at(index_);
+        }
+
+        inline const_iterator& operator ++ ()
+        {
+            ++index_;
+            return *this;
+        }
+
+        inline const_iterator operator ++ (int)
+        {
+            const_iterator result(*this);
+            ++index_;
+            return result;
+        }
+
+        inline bool operator == (const const_iterator& other) const
+        {
+            return owner_ == other.owner_ && index_ == other.index_;
+        }
+
+        inline bool operator != (const const_iterator& other) const
+        {
+            return !(*this == other);
+        }
+
+    private:
+        const array* owner_;
+        size_t index_;
+    };
+
+    array() : storage_(storage::boxed), exposed_(false)
+    {}
+    
+    array(const std::vector<std::shared_ptr<base>>& data) : base_type(data), storage_(storage::boxed), exposed_(false)
+    {
+        for(auto& element : data_)
+        {
+            adopt(*element);
+        }
+    }
+
+    // The copy holds the same elements, which stay with other; those
+    // changed through the copy are copied first (see base::own).
+    array(const array& other) :
+        base_type(other),
+        storage_(other.storage_),
+        integers_(other.integers_),
+        floats_(other.floats_),
+        exposed_(false)
+    {}
+
+    array(array&& other) :
+        base_type(std::move(other)),
+        storage_(other.storage_),
+        integers_(std::move(other.integers_)),
+        floats_(std::move(other.floats_)),
+        exposed_(other.exposed_)
+    {
+        for(auto& element : data_)
+        {
+            take_over(*element, other);
+        }
+    }
+
+    inline array& operator = (const array& other)
+    {
+        if(this != &other)
+        {
+            release_all();
+            base_type::operator = (other);
+            storage_ = other.storage_;
+            integers_ = other.integers_;
+            floats_ = other.floats_;
+            exposed_ = false;
+        }
+        return *this;
+    }
+
+    inline array& operator = (array&& other)
+    {
+        if(this != &other)
+        {
+            release_all();
+            base_type::operator = (std::move(other));
+            storage_ = other.storage_;
+            integers_ = std::move(other.integers_);
+            floats_ = std::move(other.floats_);
+            exposed_ = other.exposed_;
+            for(auto& element : data_)
+            {
+                take_over(*element, other);
+            }
+        }
+        return *this;
+    }
+
+    template<class value_data>
+    inline void add(const value_data& data)
+    {
+        add(std::make_shared<value_data>(data));
+    }
+
+    template<class value_data>
+    inline void add(const std::shared_ptr<value_data>& value)
+    {
+        changed();
+        box();
+        data_.emplace_back(std::static_pointer_cast<base>(value));
+        if(!exposed_)
+        {
+            adopt(*data_.back());
+        }
+    }
+
+    template<class value_data>
+    inline void add(const std::string&, std::shared_ptr<value_data> value)
+    {
+        add(value);
+    }
+
+    inline void add(const int_value& data)
+    {
+        add(data.get());
+    }
+
+    inline void add(const float_value& data)
+    {
+        add(data.get());
+    }
+
+    inline void add(const int& data)
+    {
+        add(static_cast<integer_type>(data));
+    }
+
+    inline void add(const integer_type& data)
+    {
+        if(pack(storage::integer))
+        {
+            changed();
+            integers_.push_back(data);
+            return;
+        }
+
+        add(std::make_shared<int_value>(data));
+    }
+
+    inline void add(const float& data)
+    {
+        add(static_cast<floating_type>(data));
+    }
+
+    inline void add(const floating_type& data)
+    {
+        if(pack(storage::floating))
+        {
+            changed();
+            floats_.push_back(data);
+            return;
+        }
+
+        add(std::make_shared<float_value>(data));
+    }
+
+    inline void add(const char* data)
+    {
+        add(std::string(data));
+    }
+
+    inline void add(const std::string& data)
+    {
+        add(string_value(data));
+    }
+
+    inline void add(const bool& data)
+    {
+        add(bool_value(data));
+    }
+
+    inline void add(const date_time& data)
+    {
+        add(date_time_value(data));
+    }
+
+    inline void append(const array& other)
+    {
+        switch(other.storage_)
+        {
+        case storage::integer:
+            for(auto value : other.integers_)
+            {
+                add(value);
+            }
+            break;
+        case storage::floating:
+            for(auto value : other.floats_)
+            {
+                add(value);
+            }
+            break;
+        default:
+            // The elements stay with other, as in a copy.
+            changed();
+            box();
+            data_.insert(data_.end(), other.data_.begin(), other.data_.end());
+            break;
+        }
+    }
+
+    inline size_t size() const
+    {
+        switch(storage_)
+        {
+        case storage::integer:
+            return integers_.size();
+        case storage::floating:
+            return floats_.size();
+        default:
+            return data_.size();
+        }
+    }
+
+    inline bool is_packed() const
+    {
+        return storage_ != storage::boxed;
+    }
+
+    // Returns an empty span unless every element is of value_data's type.
+    template<class value_data>
+    inline span<const typename value_data::value_type> get_span_as() const
+    {
+        return packed_span(static_cast<const typename value_data::value_type*>(nullptr));
+    }
+
+    inline void box()
+    {
+        switch(storage_)
+        {
+        case storage::integer:
+            data_.reserve(data_.size() + integers_.size());
+            for(auto value : integers_)
+            {
+                data_.emplace_back(std::make_shared<int_value>(value));
+                adopt(*data_.back());
+            }
+            std::vector<integer_type>().swap(integers_);
+            break;
+        case storage::floating:
+            data_.reserve(data_.size() + floats_.size());
+            for(auto value : floats_)
+            {
+                data_.emplace_back(std::make_shared<float_value>(value));
+                adopt(*data_.back());
+            }
+            std::vector<floating_type>().swap(floats_);
+            break;
+        default:
+            break;
+        }
+
+        storage_ = storage::boxed;
+    }
+
+    // The elements can be changed in any way through the result, so the
+    // array stops tracking them and no longer caches its hash.
+    inline container_type& get()
+    {
+        box();
+        own_all();
+        expose();
+        return data_;
+    }
+
+    // A copy of the elements; a packed array stays packed.
+    inline container_type get() const
+    {
+        if(storage_ == storage::boxed)
+        {
+            return data_;
+        }
+
+        container_type result;
+        result.reserve(size());
+        for(auto element : *this)
+        {
+            result.push_back(std::move(element));
+        }
+        return result;
+    }
+
+    inline std::shared_ptr<base> at(size_t index) const
+    {
+        switch(storage_)
+        {
+        case storage::integer:
+            return std::make_shared<int_value>(integers_[index]);
+        case storage::floating:
+            return std::make_shared<float_value>(floats_[index]);
+        default:
+            return data_[index];
+        }
+    }
+
+    template<class value_data>
+    inline std::shared_ptr<value_data> get_at_as(int index)
+    {
+        std::shared_ptr<base> base_type_value = operator[](index);
+        return std::dynamic_pointer_cast<value_data>(base_type_value);
+    }
+
+    template<class value_data>
+    inline std::vector<std::shared_ptr<value_data>> get_array_as()
+    {
+        box();
+        own_all();
+        std::vector<std::shared_ptr<value_data>> result(data_.size());
+
+        std::transform(data_.begin(), data_.end(), result.begin(),
+                [&](std::shared_ptr<base> data){ return std::dynamic_pointer_cast<value_data>(data); });
+
+        return result;
+    }
+
+    inline std::shared_ptr<base> operator[] (int index)
+    {
+        box();
+        if(!exposed_)
+        {
+            own(data_[index]);
+        }
+        return data_[index];
+    }
+
+    // Elements can be changed through these, but not replaced.
+    inline iterator begin()
+    {
+        box();
+        own_all();
+        return data_.cbegin();
+    }
+
+    inline iterator end()
+    {
+        box();
+        return data_.cend();
+    }
+
+    inline const_iterator begin() const
+    {
+        return const_iterator(this, 0);
+    }
+
+    inline const_iterator end() const
+    {
+        return const_iterator(this, size());
+    }
+
+    inline virtual ~array();
+
+    // Cached until a change below the array reaches it. A change made
+    // through an element that is also held by another container, or after
+    // get() handed out the elements, is not tracked; such arrays are
+    // hashed again every time.
+    inline uint64_t hash() const;
+
+    virtual void accept(std::ostream& stream) const override;
+
+    virtual inline void add_memory_usage(memory_breakdown& usage, std::unordered_set<const base*>& shared) const override
+    {
+        usage.nodes += sizeof(*this);
+        usage.containers += data_.capacity() * sizeof(data_[0]) + integers_.capacity() * sizeof(integer_type) + floats_.capacity() * sizeof(floating_type);
+        for(auto& element : data_)
+        {
+            add_child_memory_usage(element, usage, shared);
+        }
+    }
+
+    // Drops spare capacity here and below. With share_strings, or with a
+    // pool shared by several trees, equal strings also become one value,
+    // which stays with the container that held it first; a change made
+    // through that one shows in all of them, others copy it first.
+    inline void compact(bool share_strings = false);
+
+    inline void compact(string_pool& strings);
+
+    // Writes elements [first, last) without the brackets, each after a
+    // comma unless it is the first element of the array.
+    inline void accept_elements(std::ostream& stream, size_t first, size_t last) const;
+
+    // True for a non-empty array that holds only tables, which is written
+    // as [[name]] sections rather than as a value.
+    inline bool is_table_array() const
+    {
+        if(storage_ != storage::boxed || data_.empty())
+        {
+            return false;
+        }
+
+        return std::all_of(data_.begin(), data_.end(),
+                [](const std::shared_ptr<base>& element){ return element->is<table>(); });
+    }
+
+private:
+    friend class base;
+    friend class table;
+    friend void release_children(std::vector<std::shared_ptr<base>>& pending);
+
+    inline void compact_tree(string_pool* strings);
+
+    // Elements already moved out by detach_children() are empty.
+    inline void release_all()
+    {
+        for(auto& element : data_)
+        {
+            if(element)
+            {
+                release(*element);
+            }
+        }
+    }
+
+    inline void expose()
+    {
+        changed();
+        release_all();
+        exposed_ = true;
+    }
+
+    inline void own_all()
+    {
+        if(!exposed_)
+        {
+            for(auto& element : data_)
+            {
+                own(element);
+            }
+        }
+    }
+
+    inline void detach_children(std::vector<std::shared_ptr<base>>& pending)
+    {
+        release_all();
+        for(auto& element : data_)
+        {
+            if(element.use_count() == 1 && (element->is<table>() || element->is<array>()))
+            {
+                pending.push_back(std::move(element));
+            }
+        }
+    }
+
+    enum class storage
+    {
+        boxed,
+        integer,
+        floating
+    };
+
+    inline bool pack(storage kind)
+    {
+        if(storage_ == kind)
+        {
+            return true;
+        }
+
+        if(storage_ == storage::boxed)
+        {
+            if(!data_.empty())
+            {
+                return false;
+            }
+
+            storage_ = kind;
+            return true;
+        }
+
+        box();
+        return false;
+    }
+
+    inline span<const integer_type> packed_span(const integer_type*) const
+    {
+        if(storage_ == storage::integer)
+        {
+            return span<const integer_type>(integers_.data(), integers_.size());
+        }
+
+        return span<const integer_type>();
+    }
+
+    inline span<const floating_type> packed_span(const floating_type*) const
+    {
+        if(storage_ == storage::floating)
+        {
+            return span<const floating_type>(floats_.data(), floats_.size());
+        }
+
+        return span<const floating_type>();
+    }
+
+private:
+    storage storage_;
+    std::vector<integer_type> integers_;
+    std::vector<floating_type> floats_;
+    hash_cache hash_cache_;
+    bool exposed_;
+};
+
+class table : public value<std::unordered_map<std::string, std::shared_ptr<base>>, base::data_type::table>
+{
+public:
+    using base_type = value<std::unordered_map<std::string, std::shared_ptr<base>>, base::data_type::table>;
+    using container_type = typename base_type::value_type;
+        
+    // Members can be changed through iterators, but not replaced.
+    using iterator = typename container_type::const_iterator;
+    using const_iterator = typename container_type::const_iterator;
+
+    table() : exposed_(false)
+    {}
+
+    table(const std::unordered_map<std::string, std::shared_ptr<base>>& other) : base_type(other), exposed_(false)
+    {
+        adopt_all();
+    }
+
+    table(std::unordered_map<std::string, std::shared_ptr<base>>&& other) : base_type(std::move(other)), exposed_(false)
+    {
+        adopt_all();
+    }
+
+    // The copy holds the same members, which stay with other; those
+    // changed through the copy are copied first (see base::own).
+    table(const table& other) : base_type(other), exposed_(false)
+    {}
+
+    table(table&& other) : base_type(std::move(other)), exposed_(other.exposed_)
+    {
+        for(auto& member : data_)
+        {
+            take_over(*member.second, other);
+        }
+    }
+
+    inline table& operator = (const table& other)
+    {
+        if(this != &other)
+        {
+            release_all();
+            base_type::operator = (other);
+            exposed_ = false;
+        }
+        return *this;
+    }
+
+    inline table& operator = (table&& other)
+    {
+        if(this != &other)
+        {
+            release_all();
+            base_type::operator = (std::move(other));
+            exposed_ = other.exposed_;
+            for(auto& member : data_)
+            {
+                take_over(*member.second, other);
+            }
+        }
+        return *this;
+    }
+
+    // The members can be changed in any way through the result, so the
+    // table stops tracking them and no longer caches its hash.
+    inline container_type& get()
+    {
+        own_all();
+        changed();
+        release_all();
+        exposed_ = true;
+        return data_;
+    }
+
+    inline const container_type& get() const
+    {
+        return data_;
+    }
+
+    inline bool has(const std::string& key) const
+    {
+        auto find_result = data_.find(key);
+        return find_result != data_.end();
+    }
+
+    template<class value_data>
+    inline bool add(const std::string& key, const value_data& value)
+    {
+        return add(key, std::make_shared<value_data>(value));
+    }
+
+    template<class value_data>
+    inline bool add(const std::string& key, std::shared_ptr<value_data> value)
+    {
+        auto result = data_.emplace(key, std::static_pointer_cast<base>(value));
+        if(result.second)
+        {
+            changed();
+            if(!exposed_)
+            {
+                adopt(*value);
+            }
+        }
+        return result.second;
+    }
+
+    // Adds key, or gives it a new value.
+    inline void set(const std::string& key, const std::shared_ptr<base>& value)
+    {
+        changed();
+        auto& member = data_[key];
+        if(member)
+        {
+            release(*member);
+        }
+        member = value;
+        if(!exposed_)
+        {
+            adopt(*member);
+        }
+    }
+
+    // Like set(), but value stays with whatever holds it now; it is copied
+    // if it is changed through this table (see base::own).
+    inline void share(const std::string& key, const std::shared_ptr<base>& value)
+    {
+        changed();
+        auto& member = data_[key];
+        if(member)
+        {
+            release(*member);
+        }
+        member = value;
+    }
+
+    inline bool remove(const std::string& key)
+    {
+        auto find_result = data_.find(key);
+        if(find_result == data_.end())
+        {
+            return false;
+        }
+
+        changed();
+        release(*find_result->second);
+        data_.erase(find_result);
+        return true;
+    }
+
+    inline bool add(const std::string& key, const int& value)
+    {
+        return add(key, int_value(value));
+    }
+
+    inline bool add(const std::string& key, const int64_t& value)
+    {
+        return add(key, int_value(value));
+    }
+
+    inline bool add(const std::string& key, const float& value)
+    {
+        return add(key, float_value(value));
+    }
+
+    inline bool add(const std::string& key, const double& value)
+    {
+        return add(key, float_value(value));
+    }
+
+    inline bool add(const std::string& key, const std::string& value)
+    {
+        return add(key, string_value(value));
+    }
+
+    inline bool add(const std::string& key, const bool& value)
+    {
+        return add(key, bool_value(value));
+    }
+
+    inline bool add(const std::string& key, const date_time& value)
+    {
+        return add(key, date_time_value(value));
+    }
+   
+    template<class value_data>
+    inline std::shared_ptr<value_data> get_as(const std::string& key)
+    {
+        auto find_result = data_.find(key);
+        if(find_result == data_.end())
+        {
+            return nullptr;
+        }
+
+        own_member(find_result->second);
+        return std::dynamic_pointer_cast<value_data>(find_result->second);
+    }
+
+    template<class value_data>
+    inline std::vector<std::shared_ptr<value_data>> get_array_as(const std::string& key)
+    {
+        if(!has(key))
+        {
+            return std::vector<std::shared_ptr<value_data>>();
+        }
+
+        std::shared_ptr<array> array_type_value = get_as<array>(key);
+        return array_type_value->get_array_as<value_data>();
+
+    }
+
+    template<class data_type>
+    inline std::shared_ptr<data_type> create(const std::string& key)
+    {
+        if(has(key))
+        {
+            return nullptr;
+        }
+
+        auto new_data = std::make_shared<data_type>();
+        add(key, new_data);
+
+        return new_data;
+    }
+
+    inline std::shared_ptr<base> operator[](const std::string& key)
+    {
+        auto& member = data_.at(key);
+        own_member(member);
+        return member;
+    }
+
+    inline std::shared_ptr<base> operator[](const std::string& key) const
+    {
+        return data_.at(key);
+    }
+
+    inline iterator begin()
+    {
+        own_all();
+        return data_.cbegin();
+    }
+
+    inline iterator end()
+    {
+        return data_.cend();
+    }
+
+    inline const_iterator begin() const
+    {
+        return data_.begin();
+    }
+
+    inline const_iterator end() const
+    {
+        return data_.end();
+    }
+
+    inline virtual ~table();
+
+    // Cached like array::hash().
+    inline uint64_t hash() const;
+
+    virtual inline void add_memory_usage(memory_breakdown& usage, std::unordered_set<const base*>& shared) const override
+    {
+        // Each hash node holds the next pointer, the member and its cached
+        // hash; the key string in it is counted under keys.
+        usage.nodes += sizeof(*this);
+        usage.containers += data_.bucket_count() * sizeof(void*) + data_.size() * (sizeof(void*) + sizeof(container_type::mapped_type) + sizeof(size_t));
+        for(auto& i : data_)
+        {
+            usage.keys += sizeof(i.first) + memory_breakdown::heap_size(i.first);
+            add_child_memory_usage(i.second, usage, shared);
+        }
+    }
+
+    // Drops spare capacity here and below. With share_strings, or with a
+    // pool shared by several trees, equal strings also become one value,
+    // which stays with the container that held it first; a change made
+    // through that one shows in all of them, others copy it first.
+    inline void compact(bool share_strings = false);
+
+    inline void compact(string_pool& strings);
+
+    virtual inline void accept(std::ostream& stream) const override
+    {
+      std::ostringstream child_stream;
+      accept_members(stream, child_stream, std::string());
+      stream << child_stream.str();
+    }
+
+    inline void accept(std::ostream& stream, const std::string& table_name) const
+    {
+      std::ostringstream value_stream;
+      std::ostringstream child_stream;
+      accept_members(value_stream, child_stream, table_name);
+
+      // A table with neither values nor subtables still needs its header,
+      // or it would not be written at all.
+      std::string values = value_stream.str();
+      std::string children = child_stream.str();
+      if(!values.empty() || children.empty())
+      {
+        stream << "[" << table_name << "]" << std::endl << values;
+      }
+
+      stream << children;
+    }
+
+    inline void accept_array_element(std::ostream& stream, const std::string& table_name) const
+    {
+      std::ostringstream child_stream;
+      stream << "[[" << table_name << "]]" << std::endl;
+      accept_members(stream, child_stream, table_name);
+      stream << child_stream.str();
+    }
+
+    inline void accept_inline(std::ostream& stream) const
+    {
+      stream << '{';
+      bool first = true;
+      for(auto& i : data_)
+      {
+        stream << ((first) ? ("") : (", ")) << format_key(i.first) << " = ";
+        if((*i.second).is<table>())
+        {
+          static_cast<const table&>(*i.second).accept_inline(stream);
+        }
+        else
+        {
+          stream << (*i.second);
+        }
+        first = false;
+      }
+      stream << '}';
+    }
+
+private:
+    friend class base;
+    friend class array;
+    friend void release_children(std::vector<std::shared_ptr<base>>& pending);
+
+    inline void compact_tree(string_pool* strings);
+
+    inline void own_member(std::shared_ptr<base>& member)
+    {
+        if(!exposed_)
+        {
+            own(member);
+        }
+    }
+
+    inline void own_all()
+    {
+        for(auto& member : data_)
+        {
+            own_member(member.second);
+        }
+    }
+
+    inline void adopt_all()
+    {
+        for(auto& member : data_)
+        {
+            adopt(*member.second);
+        }
+    }
+
+    inline void release_all()
+    {
+        for(auto& member : data_)
+        {
+            if(member.second)
+            {
+                release(*member.second);
+            }
+        }
+    }
+
+    inline void detach_children(std::vector<std::shared_ptr<base>>& pending)
+    {
+        release_all();
+        for(auto& member : data_)
+        {
+            if(member.second.use_count() == 1 && (member.second->is<table>() || member.second->is<array>()))
+            {
+                pending.push_back(std::move(member.second));
+            }
+        }
+    }
+
+    // Values go to stream; subtables and arrays of tables go to
+    // child_stream, to be written after them.
+    inline void accept_members(std::ostream& stream, std::ostream& child_stream, const std::string& table_name) const
+    {
+      for(auto& i : data_)
+      {
+        std::string child_table_name = (table_name.empty()) ? (format_key(i.first)) : (table_name + "." + format_key(i.first));
+        if((*i.second).is<table>())
+        {
+          static_cast<const table&>(*i.second).accept(child_stream, child_table_name);
+        }
+        else if((*i.second).is<array>() && static_cast<const array&>(*i.second).is_table_array())
+        {
+          for(auto element : static_cast<const array&>(*i.second))
+          {
+            static_cast<const table&>(*element).accept_array_element(child_stream, child_table_name);
+          }
+        }
+        else
+        {
+          stream << format_key(i.first) << " = " << (*i.second) << std::endl;
+        }
+      }
+    }
+
+private:
+    hash_cache hash_cache_;
+    bool exposed_;
+};
+
+inline void base::changed()
+{
+    base* node = (type_ == data_type::array || type_ == data_type::table) ? (this) : (parent_);
+    while(node != nullptr && node->drop_cached_hash())
+    {
+        node = node->parent_;
+    }
+}
+
+// A container's hash is only cached once its children's are, so one that
+// has nothing cached has no ancestor with anything cached either.
+inline bool base::drop_cached_hash()
+{
+    switch(type_)
+    {
+    case data_type::array:
+        return static_cast<array*>(this)->hash_cache_.drop();
+    case data_type::table:
+        return static_cast<table*>(this)->hash_cache_.drop();
+    default:
+        return false;
+    }
+}
+
+inline bool base::tracks(const base& child) const
+{
+    if(child.parent_ != this)
+    {
+        return false;
+    }
+
+    switch(child.type_)
+    {
+    case data_type::array:
+        return static_cast<const array&>(child).hash_cache_.valid();
+    case data_type::table:
+        return static_cast<const table&>(child).hash_cache_.valid();
+    default:
+        return true;
+    }
+}
+
+// Destroying a table or array moves the containers only it owns onto one
+// worklist, so tearing down a deep tree costs no native stack.
+inline void release_children(std::vector<std::shared_ptr<base>>& pending)
+{
+    while(!pending.empty())
+    {
+        std::shared_ptr<base> child = std::move(pending.back());
+        pending.pop_back();
+        if(child.use_count() != 1)
+        {
+            continue;
+        }
+
+        if(child->is<table>())
+        {
+            static_cast<table&>(*child).detach_children(pending);
+        }
+        else
+        {
+            static_cast<array&>(*child).detach_children(pending);
+        }
+    }
+}
+
+inline array::~array()
+{
+    std::vector<std::shared_ptr<base>> pending;
+    detach_children(pending);
+    release_children(pending);
+}
+
+inline table::~table()
+{
+    std::vector<std::shared_ptr<base>> pending;
+    detach_children(pending);
+    release_children(pending);
+}
+
+inline void array::accept(std::ostream& stream) const
+{
+  stream << '[';
+  accept_elements(stream, 0, size());
+  stream << ']';
+}
+
+inline void array::accept_elements(std::ostream& stream, size_t first, size_t last) const
+{
+  switch(storage_)
+  {
+  case storage::integer:
+    for(size_t i = first; i < last; ++i)
+    {
+      stream << ((i == 0) ? ("") : (",")) << integers_[i];
+    }
+    break;
+  case storage::floating:
+    for(size_t i = first; i < last; ++i)
+    {
+      char buffer[float_formatter::buffer_size + 1];
+      buffer[0] = ',';
+      size_t size = float_formatter::format(floats_[i], buffer + 1);
+      stream.write(buffer + ((i == 0) ? (1) : (0)), size + ((i == 0) ? (0) : (1)));
+    }
+    break;
+  default:
+    for(size_t i = first; i < last; ++i)
+    {
+      stream << ((i == 0) ? ("") : (","));
+      if(data_[i]->is<table>())
+      {
+        static_cast<const table&>(*data_[i]).accept_inline(stream);
+      }
+      else
+      {
+        stream << *data_[i];
+      }
+    }
+    break;
+  }
+}
+
+// Structural hashing and comparison. Table hashes do not depend on the
+// order of their keys, and packed and boxed arrays with the same elements
+// hash alike.
+class structural_hash
+{
+public:
+    inline static uint64_t mix(uint64_t value)
+    {
+        value ^= value >> 30;
+        value *= 0xBF58476D1CE4E5B9ULL;
+        value ^= value >> 27;
+        value *= 0x94D049BB133111EBULL;
+        return value ^ (value >> 31);
+    }
+
+    inline static uint64_t bytes(const char* data, size_t size)
+    {
+        uint64_t result = mix(0x9E3779B97F4A7C15ULL ^ size);
+        for(; size >= 8; data += 8, size -= 8)
+        {
+            uint64_t word;
+            std::memcpy(&word, data, 8);
+            result = (result ^ mix(word)) * 0x9E3779B97F4A7C15ULL;
+        }
+
+        uint64_t tail = 0;
+        std::memcpy(&tail, data, size);
+        return mix(result ^ tail);
+    }
+
+    inline static uint64_t integer(int64_t value)
+    {
+        return mix(static_cast<uint64_t>(value) ^ 0x1000000000000001ULL);
+    }
+
+    // -0.0 equals 0.0 and every nan equals every other nan, so they hash
+    // alike as well.
+    inline static uint64_t floating(double value)
+    {
+        if(value == 0.0)
+        {
+            value = 0.0;
+        }
+        else if(std::isnan(value))
+        {
+            value = std::numeric_limits<double>::quiet_NaN();
+        }
+
+        uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        return mix(bits ^ 0x2000000000000002ULL);
+    }
+
+    inline static bool floating_equal(double lhs, double rhs)
+    {
+        return lhs == rhs || (std::isnan(lhs) && std::isnan(rhs));
+    }
+
+    inline static uint64_t node(const base& data)
+    {
+        switch(data.get_type())
+        {
+        case base::data_type::integer:
+            return integer(static_cast<const int_value&>(data).get());
+        case base::data_type::floaing:
+            return floating(static_cast<const float_value&>(data).get());
+        case base::data_type::string:
+        {
+            auto& string_data = static_cast<const string_value&>(data);
+            return bytes(string_data.data(), string_data.size());
+        }
+        case base::data_type::boolean:
+            return mix((static_cast<const bool_value&>(data).get()) ? (0x4000000000000004ULL) : (0x4000000000000003ULL));
+        case base::data_type::date:
+        {
+            auto& date = static_cast<const date_time_value&>(data).get();
+            return mix(static_cast<uint64_t>(date.time_since_epoch()) ^ mix(static_cast<uint64_t>(date.offset()) * 4 + static_cast<uint64_t>(date.get_kind())));
+        }
+        case base::data_type::array:
+            return static_cast<const array&>(data).hash();
+        case base::data_type::table:
+            return static_cast<const table&>(data).hash();
+        }
+
+        return 0;
+    }
+};
+
+inline uint64_t array::hash() const
+{
+    uint64_t result;
+    if(hash_cache_.load(result))
+    {
+        return result;
+    }
+
+    bool cacheable = !exposed_;
+    result = structural_hash::mix(0x5000000000000005ULL ^ size());
+    switch(storage_)
+    {
+    case storage::integer:
+        for(auto value : integers_)
+        {
+            result = structural_hash::mix(result ^ structural_hash::integer(value));
+        }
+        break;
+    case storage::floating:
+        for(auto value : floats_)
+        {
+            result = structural_hash::mix(result ^ structural_hash::floating(value));
+        }
+        break;
+    default:
+        for(auto& value : data_)
+        {
+            result = structural_hash::mix(result ^ structural_hash::node(*value));
+            cacheable = cacheable && tracks(*value);
+        }
+        break;
+    }
+
+    if(cacheable)
+    {
+        hash_cache_.store(result);
+    }
+    return result;
+}
+
+inline uint64_t table::hash() const
+{
+    uint64_t result;
+    if(hash_cache_.load(result))
+    {
+        return result;
+    }
+
+    // Summing the member hashes makes the result independent of iteration
+    // order.
+    bool cacheable = !exposed_;
+    uint64_t sum = 0;
+    for(auto& member : data_)
+    {
+        uint64_t key_hash = structural_hash::bytes(member.first.data(), member.first.size());
+        sum += structural_hash::mix(key_hash ^ (structural_hash::node(*member.second) * 0x9E3779B97F4A7C15ULL));
+        cacheable = cacheable && tracks(*member.second);
+    }
+
+    result = structural_hash::mix(sum ^ (0x6000000000000006ULL + data_.size()));
+    if(cacheable)
+    {
+        hash_cache_.store(result);
+    }
+    return result;
+}
+
+inline bool operator == (const table& lhs, const table& rhs);
+inline bool operator == (const array& lhs, const array& rhs);
+
+inline bool equal(const base& lhs, const base& rhs)
+{
+    if(&lhs == &rhs)
+    {
+        return true;
+    }
+
+    if(lhs.get_type() != rhs.get_type())
+    {
+        return false;
+    }
+
+    switch(lhs.get_type())
+    {
+    case base::data_type::integer:
+        return static_cast<const int_value&>(lhs).get() == static_cast<const int_value&>(rhs).get();
+    case base::data_type::floaing:
+        return structural_hash::floating_equal(static_cast<const float_value&>(lhs).get(), static_cast<const float_value&>(rhs).get());
+    case base::data_type::string:
+    {
+        auto& lhs_string = static_cast<const string_value&>(lhs);
+        auto& rhs_string = static_cast<const string_value&>(rhs);
+        return lhs_string.size() == rhs_string.size() && std::memcmp(lhs_string.data(), rhs_string.data(), lhs_string.size()) == 0;
+    }
+    case base::data_type::boolean:
+        return static_cast<const bool_value&>(lhs).get() == static_cast<const bool_value&>(rhs).get();
+    case base::data_type::date:
+        return static_cast<const date_time_value&>(lhs).get() == static_cast<const date_time_value&>(rhs).get();
+    case base::data_type::array:
+        return static_cast<const array&>(lhs) == static_cast<const array&>(rhs);
+    case base::data_type::table:
+        return static_cast<const table&>(lhs) == static_cast<const table&>(rhs);
+    }
+
+    return false;
+}
+
+inline bool operator == (const array& lhs, const array& rhs)
+{
+    if(&lhs == &rhs)
+    {
+        return true;
+    }
+
+    if(lhs.size() != rhs.size() || lhs.hash() != rhs.hash())
+    {
+        return false;
+    }
+
+    auto lhs_integers = lhs.get_span_as<int_value>();
+    auto rhs_integers = rhs.get_span_as<int_value>();
+    if(lhs_integers.size() != 0 && rhs_integers.size() != 0)
+    {
+        return std::equal(lhs_integers.begin(), lhs_integers.end(), rhs_integers.begin());
+    }
+
+    auto lhs_floats = lhs.get_span_as<float_value>();
+    auto rhs_floats = rhs.get_span_as<float_value>();
+    if(lhs_floats.size() != 0 && rhs_floats.size() != 0)
+    {
+        return std::equal(lhs_floats.begin(), lhs_floats.end(), rhs_floats.begin(), structural_hash::floating_equal);
+    }
+
+    for(size_t i = 0; i < lhs.size(); ++i)
+    {
+        auto lhs_element = lhs.at(i);
+        auto rhs_element = rhs.at(i);
+        if(lhs_element != rhs_element && !equal(*lhs_element, *rhs_element))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+inline bool operator != (const array& lhs, const array& rhs)
+{
+    return !(lhs == rhs);
+}
+
+// A hash mismatch answers most comparisons without looking at the members.
+inline bool operator == (const table& lhs, const table& rhs)
+{
+    if(&lhs == &rhs)
+    {
+        return true;
+    }
+
+    auto& lhs_data = lhs.get();
+    auto& rhs_data = rhs.get();
+    if(lhs_data.size() != rhs_data.size() || lhs.hash() != rhs.hash())
+    {
+        return false;
+    }
+
+    for(auto& member : lhs_data)
+    {
+        auto find_result = rhs_data.find(member.first);
+        if(find_result == rhs_data.end())
+        {
+            return false;
+        }
+
+        if(member.second != find_result->second && !equal(*member.second, *find_result->second))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+inline bool operator != (const table& lhs, const table& rhs)
+{
+    return !(lhs == rhs);
+}
+
+enum class difference_kind
+{
+    added,
+    removed,
+    changed
+};
+
+struct difference
+{
+    difference_kind kind;
+    std::vector<std::string> path;
+    std::shared_ptr<base> before;
+    std::shared_ptr<base> after;
+};
+
+inline void diff(const table& before, const table& after, std::vector<std::string>& path, std::vector<difference>& result)
+{
+    if(before.hash() == after.hash())
+    {
+        return;
+    }
+
+    auto& before_data = before.get();
+    auto& after_data = after.get();
+    for(auto& member : before_data)
+    {
+        path.push_back(member.first);
+
+        auto find_result = after_data.find(member.first);
+        if(find_result == after_data.end())
+        {
+            result.push_back(difference{difference_kind::removed, path, member.second, nullptr});
+        }
+        else if(member.second->is<table>() && find_result->second->is<table>())
+        {
+            diff(static_cast<const table&>(*member.second), static_cast<const table&>(*find_result->second), path, result);
+        }
+        else if(member.second != find_result->second && !equal(*member.second, *find_result->second))
+        {
+            result.push_back(difference{difference_kind::changed, path, member.second, find_result->second});
+        }
+
+        path.pop_back();
+    }
+
+    for(auto& member : after_data)
+    {
+        if(before_data.find(member.first) == before_data.end())
+        {
+            path.push_back(member.first);
+            result.push_back(difference{difference_kind::added, path, nullptr, member.second});
+            path.pop_back();
+        }
+    }
+}
+
+// Lists what changed from before to after, sorted by path. Subtables whose
+// hashes match are not descended into.
+inline std::vector<difference> diff(const table& before, const table& after)
+{
+    std::vector<std::string> path;
+    std::vector<difference> result;
+    diff(before, after, path, result);
+
+    std::sort(result.begin(), result.end(),
+            [](const difference& lhs, const difference& rhs){ return lhs.path < rhs.path; });
+    return result;
+}
+
+// Equal strings met while compacting a tree; each is kept once.
+class string_pool
+{
+public:
+    inline void intern(std::shared_ptr<base>& element)
+    {
+        if(!element->is<std::string>())
+        {
+            return;
+        }
+
+        auto result = strings_.insert(element);
+        if(result.second)
+        {
+            static_cast<string_value&>(*element).shrink_to_fit();
+        }
+        else
+        {
+            element = *result.first;
+        }
+    }
+
+    inline size_t size() const
+    {
+        return strings_.size();
+    }
+
+private:
+    struct text_hash
+    {
+        inline size_t operator()(const std::shared_ptr<base>& element) const
+        {
+            auto& text = static_cast<const string_value&>(*element);
+            return static_cast<size_t>(structural_hash::bytes(text.data(), text.size()));
+        }
+    };
+
+    struct text_equal
+    {
+        inline bool operator()(const std::shared_ptr<base>& lhs, const std::shared_ptr<base>& rhs) const
+        {
+            auto& lhs_text = static_cast<const string_value&>(*lhs);
+            auto& rhs_text = static_cast<const string_value&>(*rhs);
+            return lhs_text.size() == rhs_text.size() && std::memcmp(lhs_text.data(), rhs_text.data(), lhs_text.size()) == 0;
+        }
+    };
+
+    std::unordered_set<std::shared_ptr<base>, text_hash, text_equal> strings_;
+};
+
+inline void array::compact(bool share_strings)
+{
+    string_pool strings;
+    compact_tree((share_strings) ? (&strings) : (nullptr));
+}
+
+inline void array::compact(string_pool& strings)
+{
+    compact_tree(&strings);
+}
+
+inline void array::compact_tree(string_pool* strings)
+{
+    data_.shrink_to_fit();
+    integers_.shrink_to_fit();
+    floats_.shrink_to_fit();
+    for(auto& element : data_)
+    {
+        if(element->is<std::string>())
+        {
+            if(strings != nullptr)
+            {
+                std::shared_ptr<base> previous = element;
+                strings->intern(element);
+                if(element != previous)
+                {
+                    release(*previous);
+                }
+            }
+            else
+            {
+                static_cast<string_value&>(*element).shrink_to_fit();
+            }
+        }
+        else if(element->is<table>())
+        {
+            static_cast<table&>(*element).compact_tree(strings);
+        }
+        else if(element->is<array>())
+        {
+            static_cast<array&>(*element).compact_tree(strings);
+        }
+    }
+}
+
+inline void table::compact(bool share_strings)
+{
+    string_pool strings;
+    compact_tree((share_strings) ? (&strings) : (nullptr));
+}
+
+inline void table::compact(string_pool& strings)
+{
+    compact_tree(&strings);
+}
+
+// rehash(0) sizes the buckets for the current member count.
+inline void table::compact_tree(string_pool* strings)
+{
+    data_.rehash(0);
+    for(auto& i : data_)
+    {
+        if(i.second->is<std::string>())
+        {
+            if(strings != nullptr)
+            {
+                std::shared_ptr<base> previous = i.second;
+                strings->intern(i.second);
+                if(i.second != previous)
+                {
+                    release(*previous);
+                }
+            }
+            else
+            {
+                static_cast<string_value&>(*i.second).shrink_to_fit();
+            }
+        }
+        else if(i.second->is<table>())
+        {
+            static_cast<table&>(*i.second).compact_tree(strings);
+        }
+        else if(i.second->is<array>())
+        {
+            static_cast<array&>(*i.second).compact_tree(strings);
+        }
+    }
+}
+
+enum class array_merge_policy
+{
+    replace,
+    append
+};
+
+enum class table_merge_policy
+{
+    replace,
+    deep
+};
+
+struct merge_policy
+{
+    merge_policy(array_merge_policy array_policy = array_merge_policy::replace,
+                 table_merge_policy table_policy = table_merge_policy::deep) :
+        arrays(array_policy),
+        tables(table_policy)
+    {}
+
+    array_merge_policy arrays;
+    table_merge_policy tables;
+};
+
+// A copy of node alone. What is below it is shared with node until it is
+// changed through the copy, which copies that part then (see base::own).
+inline std::shared_ptr<base> shallow_copy(const std::shared_ptr<base>& node)
+{
+    if(!node)
+    {
+        return node;
+    }
+
+    switch(node->get_type())
+    {
+    case base::data_type::integer:
+        return std::make_shared<int_value>(static_cast<const int_value&>(*node));
+    case base::data_type::floaing:
+        return std::make_shared<float_value>(static_cast<const float_value&>(*node));
+    case base::data_type::string:
+        return std::make_shared<string_value>(static_cast<const string_value&>(*node));
+    case base::data_type::boolean:
+        return std::make_shared<bool_value>(static_cast<const bool_value&>(*node));
+    case base::data_type::date:
+        return std::make_shared<date_time_value>(static_cast<const date_time_value&>(*node));
+    case base::data_type::array:
+        return std::make_shared<array>(static_cast<const array&>(*node));
+    case base::data_type::table:
+        return std::make_shared<table>(static_cast<const table&>(*node));
+    }
+
+    return node;
+}
+
+// One that nothing else holds any more is taken over instead.
+inline void base::own(std::shared_ptr<base>& child)
+{
+    if(child->parent_ == this)
+    {
+        return;
+    }
+
+    if(child->parent_ != nullptr || child.use_count() != 1)
+    {
+        child = shallow_copy(child);
+    }
+    child->parent_ = this;
+}
+
+// A copy of node and everything below it, sharing nothing with it, not
+// even the source text that parsed strings may still point into.
+inline std::shared_ptr<base> deep_copy(const std::shared_ptr<base>& node)
+{
+    if(!node)
+    {
+        return node;
+    }
+
+    switch(node->get_type())
+    {
+    case base::data_type::string:
+    {
+        auto& string_data = static_cast<const string_value&>(*node);
+        return std::make_shared<string_value>(std::string(string_data.data(), string_data.size()));
+    }
+    case base::data_type::array:
+    {
+        auto& elements = static_cast<const array&>(*node);
+        if(elements.is_packed())
+        {
+            return std::make_shared<array>(elements);
+        }
+
+        auto result = std::make_shared<array>();
+        for(auto element : elements)
+        {
+            result->add(deep_copy(element));
+        }
+        return result;
+    }
+    case base::data_type::table:
+    {
+        auto result = std::make_shared<table>();
+        for(auto& member : static_cast<const table&>(*node))
+        {
+            result->add(member.first, deep_copy(member.second));
+        }
+        return result;
+    }
+    default:
+        return shallow_copy(node);
+    }
+}
+
+// True if upper is merged into lower in place rather than replacing it.
+inline bool merges(const base& lower, const base& upper, const merge_policy& policy)
+{
+    return (lower.is<table>() && upper.is<table>() && policy.tables == table_merge_policy::deep) ||
+           (lower.is<array>() && upper.is<array>() && policy.arrays == array_merge_policy::append);
+}
+
+inline void overlay(table& target, const table& layer, const merge_policy& policy = merge_policy());
+
+// Puts upper on top of target, which belongs to the caller and is changed in
+// place. What is taken from upper is shared with it, not copied; changing it
+// through target copies it then.
+inline void merge_into(std::shared_ptr<base>& target, const std::shared_ptr<base>& upper, const merge_policy& policy)
+{
+    if(!target || !merges(*target, *upper, policy))
+    {
+        target = upper;
+    }
+    else if(target->is<table>())
+    {
+        overlay(static_cast<table&>(*target), static_cast<const table&>(*upper), policy);
+    }
+    else
+    {
+        static_cast<array&>(*target).append(static_cast<const array&>(*upper));
+    }
+}
+
+// The result shares every node it did not change with lower and upper;
+// changing it copies the nodes on the way to the change, leaving lower
+// and upper as they were. They must not be changed in place meanwhile.
+inline std::shared_ptr<base> merge(const std::shared_ptr<base>& lower, const std::shared_ptr<base>& upper, const merge_policy& policy = merge_policy())
+{
+    if(!lower || !merges(*lower, *upper, policy))
+    {
+        return shallow_copy(upper);
+    }
+
+    auto result = shallow_copy(lower);
+    merge_into(result, upper, policy);
+    return result;
+}
+
+// Members of target that are merged with layer's are copied first if
+// target shares them; everything else taken from layer is shared.
+inline void overlay(table& target, const table& layer, const merge_policy& policy)
+{
+    auto& data = static_cast<const table&>(target).get();
+    for(auto& i : layer)
+    {
+        auto find_result = data.find(i.first);
+        if(find_result != data.end() && merges(*find_result->second, *i.second, policy))
+        {
+            std::shared_ptr<base> member = target[i.first];
+            merge_into(member, i.second, policy);
+        }
+        else
+        {
+            target.share(i.first, i.second);
+        }
+    }
+}
+
+inline table merge(const table& lower, const table& upper, const merge_policy& policy = merge_policy())
+{
+    table result;
+    overlay(result, lower, policy);
+    overlay(result, upper, policy);
+    return result;
+}
+
+// Resolves lookups against a stack of layers without building a merged tree.
+// Later layers take precedence; replacing one layer leaves the others untouched.
+class overlay_view
+{
+public:
+    using layer_type = std::shared_ptr<const table>;
+
+    overlay_view(const merge_policy& policy = merge_policy()) : policy_(policy)
+    {}
+
+    overlay_view(const std::vector<layer_type>& layers, const merge_policy& policy = merge_policy()) :
+        layers_(layers),
+        policy_(policy)
+    {}
+
+    inline size_t add_layer(const layer_type& layer)
+    {
+        layers_.emplace_back(layer);
+        return layers_.size() - 1;
+    }
+
+    inline void set_layer(size_t index, const layer_type& layer)
+    {
+        layers_.at(index) = layer;
+    }
+
+    inline const layer_type& layer(size_t index) const
+    {
+        return layers_.at(index);
+    }
+
+    inline size_t size() const
+    {
+        return layers_.size();
+    }
+
+    inline bool has(const std::string& key) const
+    {
+        for(auto& i : layers_)
+        {
+            if(i && i->has(key))
+            {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    // A merged value that shares its unchanged nodes with the layers, as
+    // merge() does; use view() to look below a table without merging it.
+    inline std::shared_ptr<base> find(const std::string& key) const
+    {
+        std::shared_ptr<base> result;
+        bool copied = false;
+        for(auto& i : layers_)
+        {
+            if(!i)
+            {
+                continue;
+            }
+
+            auto find_result = i->get().find(key);
+            if(find_result == i->end())
+            {
+                continue;
+            }
+
+            if(result && merges(*result, *find_result->second, policy_))
+            {
+                if(!copied)
+                {
+                    result = shallow_copy(result);
+                    copied = true;
+                }
+                merge_into(result, find_result->second, policy_);
+            }
+            else
+            {
+                result = find_result->second;
+                copied = false;
+            }
+        }
+
+        return (copied) ? (result) : (shallow_copy(result));
+    }
+
+    template<class value_data>
+    inline std::shared_ptr<value_data> get_as(const std::string& key) const
+    {
+        return std::dynamic_pointer_cast<value_data>(find(key));
+    }
+
+    inline overlay_view view(const std::string& key) const
+    {
+        std::vector<layer_type> child_layers;
+        for(auto i = layers_.rbegin(); i != layers_.rend(); ++i)
+        {
+            if(!(*i))
+            {
+                continue;
+            }
+
+            auto find_result = (*i)->get().find(key);
+            if(find_result == (*i)->end())
+            {
+                continue;
+            }
+
+            if(!find_result->second->is<table>())
+            {
+                break;
+            }
+
+            child_layers.emplace_back(std::static_pointer_cast<const table>(find_result->second));
+            if(policy_.tables == table_merge_policy::replace)
+            {
+                break;
+            }
+        }
+
+        std::reverse(child_layers.begin(), child_layers.end());
+        return overlay_view(child_layers, policy_);
+    }
+
+    inline table materialize() const
+    {
+        table result;
+        for(auto& i : layers_)
+        {
+            if(i)
+            {
+                overlay(result, *i, policy_);
+            }
+        }
+
+        return result;
+    }
+
+private:
+    std::vector<layer_type> layers_;
+    merge_policy policy_;
+};
+
+class parse_exception : public std::runtime_error
+{
+public:
+    parse_exception(const std::string& message) : std::runtime_error(message)
+    {}
+
+    parse_exception(const std::string& message, unsigned int line) : std::runtime_error(message + " at line " + std::to_string(line))
+    {}
+};
+
+struct source_range
+{
+    size_t begin;
+    size_t end;
+    unsigned int line;
+};
+
+// Byte scanning shared by the string parsers. The SSE2 paths look at 16
+// bytes per step; everything else falls back to the scalar loops.
+class string_scanner
+{
+public:
+    // Returns the first byte that ends a plain run of string content: the
+    // quote, a backslash in basic strings, or a control character other than
+    // tab. Sets non_ascii when a byte >= 0x80 was passed over.
+    inline static const char* find_special(const char* position, const char* end, char quote, bool basic, bool& non_ascii)
+    {
+#if defined(__SSE2__)
+        const __m128i quotes = _mm_set1_epi8(quote);
+        const __m128i backslashes = _mm_set1_epi8((basic) ? ('\\') : (quote));
+        const __m128i controls = _mm_set1_epi8(0x1F);
+        const __m128i tabs = _mm_set1_epi8('\t');
+        const __m128i deletes = _mm_set1_epi8(0x7F);
+
+        while(end - position >= 16)
+        {
+            __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(position));
+            __m128i control = _mm_andnot_si128(_mm_cmpeq_epi8(chunk, tabs), _mm_cmpeq_epi8(_mm_min_epu8(chunk, controls), chunk));
+            __m128i special = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, quotes), _mm_cmpeq_epi8(chunk, backslashes)),
+                                           _mm_or_si128(control, _mm_cmpeq_epi8(chunk, deletes)));
+
+            unsigned int special_bits = static_cast<unsigned int>(_mm_movemask_epi8(special));
+            unsigned int high_bits = static_cast<unsigned int>(_mm_movemask_epi8(chunk));
+            if(special_bits != 0)
+            {
+                unsigned int index = count_trailing_zeros(special_bits);
+                non_ascii = non_ascii || (high_bits & ((1u << index) - 1)) != 0;
+                return position + index;
+            }
+
+            non_ascii = non_ascii || high_bits != 0;
+            position += 16;
+        }
+#endif
+
+        for(; position != end; ++position)
+        {
+            unsigned char c = static_cast<unsigned char>(*position);
+            if(c == static_cast<unsigned char>(quote) || (c == '\\' && basic) || (c < 0x20 && c != '\t') || c == 0x7F)
+            {
+                break;
+            }
+
+            non_ascii = non_ascii || c >= 0x80;
+        }
+
+        return position;
+    }
+
+    inline static bool validate_utf8(const char* position, const char* end)
+    {
+        while(position != end)
+        {
+#if defined(__SSE2__)
+            if(end - position >= 16 && _mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(position))) == 0)
+            {
+                position += 16;
+                continue;
+            }
+#endif
+            unsigned char lead = static_cast<unsigned char>(*position);
+            if(lead < 0x80)
+            {
+                ++position;
+                continue;
+            }
+
+            int length;
+            uint32_t code_point;
+            uint32_t minimum;
+            if((lead & 0xE0) == 0xC0)
+            {
+                length = 2;
+                code_point = lead & 0x1F;
+                minimum = 0x80;
+            }
+            else if((lead & 0xF0) == 0xE0)
+            {
+                length = 3;
+                code_point = lead & 0x0F;
+                minimum = 0x800;
+            }
+            else if((lead & 0xF8) == 0xF0)
+            {
+                length = 4;
+                code_point = lead & 0x07;
+                minimum = 0x10000;
+            }
+            else
+            {
+                return false;
+            }
+
+            if(end - position < length)
+            {
+                return false;
+            }
+
+            for(int i = 1; i < length; ++i)
+            {
+                unsigned char c = static_cast<unsigned char>(position[i]);
+                if((c & 0xC0) != 0x80)
+                {
+                    return false;
+                }
+                code_point = (code_point << 6) | (c & 0x3F);
+            }
+
+            if(code_point < minimum || code_point > 0x10FFFF || (0xD800 <= code_point && code_point <= 0xDFFF))
+            {
+                return false;
+            }
+
+            position += length;
+        }
+
+        return true;
+    }
+
+private:
+    inline static unsigned int count_trailing_zeros(unsigned int bits)
+    {
+#if defined(__GNUC__)
+        return static_cast<unsigned int>(__builtin_ctz(bits));
+#else
+        unsigned int count = 0;
+        for(; (bits & 1) == 0; bits >>= 1)
+        {
+            ++count;
+        }
+        return count;
+#endif
+    }
+};
+
+// Handler of basic_push_parser that builds the table tree.
+class table_builder
+{
+public:
+    table_builder() : current_(&root_), target_(&root_), source_begin_(nullptr), source_end_(nullptr)
+    {}
+
+    table_builder(const table_builder&) = delete;
+    table_builder& operator = (const table_builder&) = delete;
+
+    inline void table_header(const std::vector<std::string>& path, const source_range& range)
+    {
+        table* current = resolve_parent(path, range);
+
+        auto& data = static_cast<const table*>(current)->get();
+        auto find_result = data.find(path.back());
+        if(find_result == data.end())
+        {
+            auto child = std::make_shared<table>();
+            current->add(path.back(), child);
+            current = child.get();
+        }
+        else if(find_result->second->is<table>())
+        {
+            current = static_cast<table*>(find_result->second.get());
+        }
+        else
+        {
+            throw parse_exception("key is not a table:" + path.back(), range.line);
+        }
+
+        // Dotted keys define the tables they make, too.
+        if(dotted_.count(current) != 0 || !defined_.insert(current).second)
+        {
+            throw parse_exception("table is already defined:" + path.back(), range.line);
+        }
+
+        set_current(current);
+    }
+
+    inline void array_table_header(const std::vector<std::string>& path, const source_range& range)
+    {
+        table* parent = resolve_parent(path, range);
+
+        auto& data = static_cast<const table*>(parent)->get();
+        auto find_result = data.find(path.back());
+        array* tables = nullptr;
+        if(find_result == data.end())
+        {
+            auto created = std::make_shared<array>();
+            parent->add(path.back(), created);
+            tables = created.get();
+            table_arrays_.insert(tables);
+        }
+        else if(find_result->second->is<array>() && table_arrays_.count(static_cast<array*>(find_result->second.get())) != 0)
+        {
+            tables = static_cast<array*>(find_result->second.get());
+        }
+        else
+        {
+            throw parse_exception("key is not an array of tables:" + path.back(), range.line);
+        }
+
+        auto element = std::make_shared<table>();
+        tables->add(element);
+        set_current(element.get());
+    }
+
+    inline void key(const std::vector<std::string>& path, const source_range& range)
+    {
+        table* target = (containers_.empty()) ? (current_) : (containers_.back().object);
+        for(size_t i = 0; i + 1 < path.size(); ++i)
+        {
+            auto& data = static_cast<const table*>(target)->get();
+            auto find_result = data.find(path[i]);
+            if(find_result == data.end())
+            {
+                auto child = std::make_shared<table>();
+                target->add(path[i], child);
+                target = child.get();
+                dotted_.insert(target);
+            }
+            else if(find_result->second->is<table>())
+            {
+                // Only tables made by other dotted keys can be added to this
+                // way; not a [table], and not an inline table.
+                target = static_cast<table*>(find_result->second.get());
+                if(defined_.count(target) != 0)
+                {
+                    throw parse_exception("table is already defined:" + path[i], range.line);
+                }
+            }
+            else
+            {
+                throw parse_exception("key is not a table:" + path[i], range.line);
+            }
+        }
+
+        if(target->has(path.back()))
+        {
+            throw parse_exception("duplicate key:" + path.back(), range.line);
+        }
+
+        target_ = target;
+        key_ = path.back();
+    }
+
+    inline void integer(int64_t value, const source_range&)
+    {
+        add_value(value);
+    }
+
+    inline void floating(double value, const source_range&)
+    {
+        add_value(value);
+    }
+
+    inline void string(const char* data, size_t size, const source_range&)
+    {
+        if(source_begin_ != nullptr && std::less_equal<const char*>()(source_begin_, data) && std::less_equal<const char*>()(data + size, source_end_))
+        {
+            add_value(std::make_shared<string_value>(string_value::view(data, size)));
+        }
+        else
+        {
+            add_value(std::make_shared<string_value>(std::string(data, size)));
+        }
+    }
+
+    inline void boolean(bool value, const source_range&)
+    {
+        add_value(value);
+    }
+
+    inline void date(const date_time& value, const source_range&)
+    {
+        add_value(value);
+    }
+
+    inline void begin_array(const source_range&)
+    {
+        auto created = std::make_shared<array>();
+        add_value(created);
+        containers_.push_back(container{nullptr, created.get()});
+    }
+
+    inline void end_array(const source_range&)
+    {
+        containers_.pop_back();
+    }
+
+    inline void begin_inline_table(const source_range&)
+    {
+        auto created = std::make_shared<table>();
+        add_value(created);
+        defined_.insert(created.get());
+        inline_tables_.insert(created.get());
+        containers_.push_back(container{created.get(), nullptr});
+    }
+
+    inline void end_inline_table(const source_range&)
+    {
+        containers_.pop_back();
+    }
+
+    inline table& root()
+    {
+        return root_;
+    }
+
+    // Strings that are read unchanged from [data, data + size) become views
+    // into it instead of copies, until the next reset().
+    inline void set_source(const char* data, size_t size)
+    {
+        source_begin_ = data;
+        source_end_ = data + size;
+    }
+
+    inline table release()
+    {
+        table result(std::move(root_));
+        reset();
+        return result;
+    }
+
+    inline void reset()
+    {
+        root_ = table();
+        current_ = &root_;
+        target_ = &root_;
+        defined_.clear();
+        dotted_.clear();
+        inline_tables_.clear();
+        table_arrays_.clear();
+        containers_.clear();
+        header_path_.clear();
+        header_tables_.clear();
+        source_begin_ = nullptr;
+        source_end_ = nullptr;
+    }
+
+private:
+    struct container
+    {
+        table* object;
+        array* elements;
+    };
+
+    template<class value_data>
+    inline void add_value(const value_data& value)
+    {
+        if(!containers_.empty() && containers_.back().elements != nullptr)
+        {
+            containers_.back().elements->add(value);
+        }
+        else
+        {
+            target_->add(key_, value);
+        }
+    }
+
+    // The tables the previous header went through are remembered, so a
+    // header that shares a prefix with it (such as a repeated [[a.b]]) only
+    // walks the segments after the shared part.
+    inline table* resolve_parent(const std::vector<std::string>& path, const source_range& range)
+    {
+        size_t shared = 0;
+        size_t limit = std::min(path.size() - 1, header_path_.size());
+        while(shared < limit && path[shared] == header_path_[shared])
+        {
+            ++shared;
+        }
+
+        header_path_ = path;
+        header_tables_.resize(shared);
+
+        table* current = (shared == 0) ? (&root_) : (header_tables_.back());
+        for(size_t i = shared; i + 1 < path.size(); ++i)
+        {
+            auto& data = static_cast<const table*>(current)->get();
+            auto find_result = data.find(path[i]);
+            if(find_result == data.end())
+            {
+                auto child = std::make_shared<table>();
+                current->add(path[i], child);
+                current = child.get();
+            }
+            else if(find_result->second->is<table>() && inline_tables_.count(static_cast<const table*>(find_result->second.get())) == 0)
+            {
+                current = static_cast<table*>(find_result->second.get());
+            }
+            else if(find_result->second->is<array>() && table_arrays_.count(static_cast<array*>(find_result->second.get())) != 0)
+            {
+                auto& tables = static_cast<const array&>(*find_result->second);
+                current = static_cast<table*>(tables.at(tables.size() - 1).get());
+            }
+            else
+            {
+                throw parse_exception("key is not a table:" + path[i], range.line);
+            }
+
+            header_tables_.push_back(current);
+        }
+
+        return current;
+    }
+
+    inline void set_current(table* current)
+    {
+        header_tables_.push_back(current);
+        current_ = current;
+        target_ = current;
+    }
+
+private:
+    table root_;
+    table* current_;
+    table* target_;
+    std::string key_;
+    std::unordered_set<const table*> defined_;
+    std::unordered_set<const table*> dotted_;
+    std::unordered_set<const table*> inline_tables_;
+    std::unordered_set<const array*> table_arrays_;
+    std::vector<container> containers_;
+    std::vector<std::string> header_path_;
+    std::vector<table*> header_tables_;
+    const char* source_begin_;
+    const char* source_end_;
+};
+
+// Parses a document that arrives in chunks of any size and reports what it
+// finds to handler_type (see table_builder for the events). Complete statements
+// are parsed straight out of the fed chunk; only a statement that is cut off by
+// the end of a chunk is kept in the carry-over buffer until the rest arrives.
+template<class handler_type>
+class basic_push_parser
+{
+private:
+    enum class parse_type
+    {
+        error,
+        number,
+        string,
+        boolean,
+        date,
+        array,
+        table 
+    };
+
+public:
+    basic_push_parser(handler_type& handler) :
+        handler_(handler),
+        string_begin_(nullptr),
+        string_end_(nullptr),
+        string_decoded_(false),
+        statement_start_(nullptr),
+        position_(0),
+        line_(1),
+        max_depth_(default_max_depth)
+    {}
+
+    // Tables, arrays and dotted keys nested deeper than this are rejected;
+    // hashing, comparing and writing a tree recurse once per level.
+    static const size_t default_max_depth = 512;
+
+    inline void set_max_depth(size_t max_depth)
+    {
+        max_depth_ = max_depth;
+    }
+
+    basic_push_parser(const basic_push_parser&) = delete;
+    basic_push_parser& operator = (const basic_push_parser&) = delete;
+
+    inline void feed(const char* data, size_t size)
+    {
+        const char* start = data;
+        const char* end = data + size;
+
+        if(!carry_.empty())
+        {
+            auto newline = static_cast<const char*>(std::memchr(start, '\n', size));
+            const char* carry_end = (newline != nullptr) ? (newline + 1) : (end);
+            carry_.append(start, carry_end);
+            start = carry_end;
+
+            consume_carry(false);
+            if(!carry_.empty())
+            {
+                carry_.append(start, end);
+                consume_carry(false);
+                return;
+            }
+        }
+
+        start = parse_statements(start, end, false);
+        carry_.assign(start, end);
+    }
+
+    inline void feed(const std::string& data)
+    {
+        feed(data.data(), data.size());
+    }
+
+    // Parses a whole document in place; nothing is copied to the carry-over
+    // buffer, so every string the handler sees points into data or the
+    // decoding scratch.
+    inline void parse(const char* data, size_t size)
+    {
+        if(!carry_.empty())
+        {
+            feed(data, size);
+            finish();
+            return;
+        }
+
+        parse_statements(data, data + size, true);
+    }
+
+    inline void finish()
+    {
+        consume_carry(true);
+    }
+
+    inline void reset()
+    {
+        carry_.clear();
+        scan_ = statement_scan();
+        position_ = 0;
+        line_ = 1;
+    }
+
+    inline size_t carry_size() const
+    {
+        return carry_.size();
+    }
+
+    inline unsigned int line() const
+    {
+        return line_;
+    }
+
+    // For callers that step through a document held in memory one piece at
+    // a time (see record_cursor). Each call must start where the previous
+    // one stopped.
+    inline const char* parse_next_statement(const char* start, const char* end)
+    {
+        return advance(start, parse_statement(start, end, true));
+    }
+
+    // Reads a key and its '='; returns where the value starts.
+    inline const char* parse_next_key(const char* start, const char* end)
+    {
+        statement_start_ = start;
+        return advance(start, parse_key(consume_whitespace_toward_front(start, end), end));
+    }
+
+    inline const char* parse_next_value(const char* start, const char* end)
+    {
+        statement_start_ = start;
+        return advance(start, parse_value(start, end));
+    }
+
+    // Steps over an array's '[' to its first element; closed is set, and
+    // the ']' skipped, when it has none.
+    inline const char* parse_next_array_open(const char* start, const char* end, bool& closed)
+    {
+        statement_start_ = start;
+        if(start == end || *start != '[')
+        {
+            throw parse_exception("expected '[':" + line_text(start, end), line_);
+        }
+
+        return advance(start, parse_array_close(skip_array_space(start + 1, end), end, closed));
+    }
+
+    // Steps from just past an element to the next one, as above.
+    inline const char* parse_next_array_separator(const char* start, const char* end, bool& closed)
+    {
+        statement_start_ = start;
+        const char* position = skip_array_space(start, end);
+        if(position != end && *position == ',')
+        {
+            position = skip_array_space(position + 1, end);
+        }
+        else if(position == end || *position != ']')
+        {
+            throw parse_exception("expected ',' or ']':" + line_text(position, end), line_);
+        }
+
+        return advance(start, parse_array_close(position, end, closed));
+    }
+
+    inline const char* parse_next_line_end(const char* start, const char* end)
+    {
+        statement_start_ = start;
+        return advance(start, parse_line_end(start, start, end));
+    }
+
+private:
+    inline const char* advance(const char* start, const char* next)
+    {
+        position_ += next - start;
+        return next;
+    }
+
+    // How far find_statement_end got into the statement at the front of
+    // the carry-over, and what it was inside of there.
+    struct statement_scan
+    {
+        statement_scan() : offset(0), depth(0), quote('\0'), multi_line(false), comment(false)
+        {}
+
+        size_t offset;
+        int depth;
+        char quote;
+        bool multi_line;
+        bool comment;
+    };
+
+    inline const char* parse_array_close(const char* position, const char* end, bool& closed)
+    {
+        closed = (position != end && *position == ']');
+        return (closed) ? (position + 1) : (position);
+    }
+
+    inline void consume_carry(bool final)
+    {
+        const char* carry_start = carry_.data();
+        const char* parsed_end = parse_statements(carry_start, carry_start + carry_.size(), final);
+        carry_.erase(0, parsed_end - carry_start);
+        if(final)
+        {
+            scan_ = statement_scan();
+        }
+    }
+
+    inline const char* parse_statements(const char* start, const char* end, bool final)
+    {
+        while(start != end)
+        {
+            const char* next = parse_statement(start, end, final);
+            if(next == nullptr)
+            {
+                break;
+            }
+
+            position_ += next - start;
+            start = next;
+        }
+
+        return start;
+    }
+
+    inline const char* parse_statement(const char* start, const char* end, bool final)
+    {
+        if(!final)
+        {
+            end = find_statement_end(start, end);
+            if(end == nullptr)
+            {
+                return nullptr;
+            }
+        }
+
+        statement_start_ = start;
+
+        const char* position = consume_whitespace_toward_front(start, end);
+        if(position != end && *position == '[')
+        {
+            position = parse_table_header(position, end);
+        }
+        else if(position != end && *position != '#' && *position != '\n' && *position != '\r')
+        {
+            position = parse_key_value_pair(position, end);
+        }
+
+        return parse_line_end(position, start, end);
+    }
+
+    // Finds the newline that ends the statement at start without parsing it:
+    // strings and brackets may carry a statement over several lines. When
+    // there is none yet, scan_ keeps where the search stopped so the next
+    // feed resumes there instead of rescanning the carry-over.
+    inline const char* find_statement_end(const char* start, const char* end)
+    {
+        const char* position = start + scan_.offset;
+        while(position != end)
+        {
+            if(scan_.comment)
+            {
+                position = static_cast<const char*>(std::memchr(position, '\n', end - position));
+                if(position == nullptr)
+                {
+                    position = end;
+                    break;
+                }
+                scan_.comment = false;
+                continue;
+            }
+
+            if(scan_.quote != '\0')
+            {
+                position = skip_string(position, end);
+                if(scan_.quote != '\0')
+                {
+                    break;
+                }
+                continue;
+            }
+
+            switch(*position)
+            {
+            case '\n':
+                if(scan_.depth <= 0)
+                {
+                    scan_ = statement_scan();
+                    return position + 1;
+                }
+                ++position;
+                break;
+            case '#':
+                scan_.comment = true;
+                break;
+            case '[':
+            case '{':
+                ++scan_.depth;
+                ++position;
+                break;
+            case ']':
+            case '}':
+                --scan_.depth;
+                ++position;
+                break;
+            case '"':
+            case '\'':
+                // Whether the string is multi-line takes all three quotes.
+                if(end - position < 3)
+                {
+                    scan_.offset = position - start;
+                    return nullptr;
+                }
+                scan_.quote = *position;
+                scan_.multi_line = (position[1] == scan_.quote && position[2] == scan_.quote);
+                position += (scan_.multi_line) ? (3) : (1);
+                break;
+            default:
+                ++position;
+                break;
+            }
+        }
+
+        scan_.offset = position - start;
+        return nullptr;
+    }
+
+    // Steps over the rest of the string scan_ is in; scan_.quote is cleared
+    // once it is closed, otherwise the result is where to resume.
+    inline const char* skip_string(const char* position, const char* end)
+    {
+        char quote = scan_.quote;
+        while(position != end)
+        {
+            if(*position == '\\' && quote == '"')
+            {
+                if(end - position < 2)
+                {
+                    return position;
+                }
+                position += 2;
+                continue;
+            }
+
+            if(*position == '\n' && !scan_.multi_line)
+            {
+                scan_.quote = '\0';
+                return position;
+            }
+
+            if(*position != quote)
+            {
+                ++position;
+                continue;
+            }
+
+            if(!scan_.multi_line)
+            {
+                scan_.quote = '\0';
+                return position + 1;
+            }
+
+            const char* quotes_end = position;
+            while(quotes_end != end && *quotes_end == quote)
+            {
+                ++quotes_end;
+            }
+
+            if(quotes_end == end)
+            {
+                return position;
+            }
+
+            if(quotes_end - position >= 3)
+            {
+                scan_.quote = '\0';
+                return quotes_end;
+            }
+            position = quotes_end;
+        }
+
+        return position;
+    }
+
+    inline const char* parse_line_end(const char* position, const char* line_start, const char* end)
+    {
+        position = consume_whitespace_toward_front(position, end);
+        if(position != end && *position == '#')
+        {
+            position = static_cast<const char*>(std::memchr(position, '\n', end - position));
+            if(position == nullptr)
+            {
+                return end;
+            }
+        }
+
+        if(position != end && *position == '\r' && position + 1 != end && *(position + 1) == '\n')
+        {
+            ++position;
+        }
+
+        if(position == end)
+        {
+            return end;
+        }
+
+        if(*position != '\n')
+        {
+            throw parse_exception("unexpected character:" + line_text(line_start, end), line_);
+        }
+
+        ++line_;
+        return position + 1;
+    }
+
+    inline const char* parse_table_header(const char* start, const char* end)
+    {
+        bool array_table = (end - start >= 2 && start[1] == '[');
+
+        const char* position = parse_key_path(start + ((array_table) ? (2) : (1)), end, path_);
+        if(position == end || *position != ']' || (array_table && (end - position < 2 || position[1] != ']')))
+        {
+            throw parse_exception("expected ']' after table name:" + line_text(start, end), line_);
+        }
+        position += (array_table) ? (2) : (1);
+
+        if(array_table)
+        {
+            handler_.array_table_header(path_, range(start, position));
+        }
+        else
+        {
+            handler_.table_header(path_, range(start, position));
+        }
+
+        return position;
+    }
+
+    inline const char* parse_key_value_pair(const char* key_start, const char* end)
+    {
+        return parse_value(parse_key(key_start, end), end);
+    }
+
+    // Reads a (possibly dotted) key and the '=' after it.
+    inline const char* parse_key(const char* key_start, const char* end)
+    {
+        const char* position = parse_key_path(key_start, end, key_path_);
+        handler_.key(key_path_, range(key_start, position));
+
+        if(position == end || *position != '=')
+        {
+            throw parse_exception("expected '=' after key:" + line_text(key_start, end), line_);
+        }
+
+        return consume_whitespace_toward_front(position + 1, end);
+    }
+
+    inline const char* parse_key_path(const char* position, const char* end, std::vector<std::string>& path)
+    {
+        path.clear();
+        while(true)
+        {
+            position = consume_whitespace_toward_front(position, end);
+
+            if(path.size() == max_depth_)
+            {
+                throw parse_exception("key is nested too deeply", line_);
+            }
+
+            path.emplace_back();
+            position = parse_key_segment(position, end, path.back());
+
+            position = consume_whitespace_toward_front(position, end);
+            if(position == end || *position != '.')
+            {
+                return position;
+            }
+            ++position;
+        }
+    }
+
+    inline const char* parse_key_segment(const char* start, const char* end, std::string& key)
+    {
+        if(start != end && (*start == '"' || *start == '\''))
+        {
+            if(end - start >= 3 && start[1] == *start && start[2] == *start)
+            {
+                throw parse_exception("multi-line string can not be a key:" + line_text(start, end), line_);
+            }
+
+            const char* position = parse_string(start, end);
+            if(string_decoded_)
+            {
+                key.swap(string_);
+            }
+            else
+            {
+                key.assign(string_begin_, string_end_);
+            }
+
+            return position;
+        }
+
+        const char* key_end = start;
+        while(key_end != end && is_bare_key(*key_end))
+        {
+            ++key_end;
+        }
+
+        if(key_end == start)
+        {
+            throw parse_exception("key is empty:" + line_text(start, end), line_);
+        }
+
+        key.assign(start, key_end);
+        return key_end;
+    }
+
+    // Leaves the value in [string_begin_, string_end_) of the source when it
+    // has no escapes, so the common case is never copied; otherwise decodes
+    // it into string_.
+    inline const char* parse_string(const char* start, const char* end)
+    {
+        char quote = *start;
+        bool basic = (quote == '"');
+        bool multi_line = (end - start >= 3 && start[1] == quote && start[2] == quote);
+
+        const char* position = start + ((multi_line) ? (3) : (1));
+        if(multi_line && position != end && (*position == '\n' || (*position == '\r' && position + 1 != end && *(position + 1) == '\n')))
+        {
+            position += (*position == '\n') ? (1) : (2);
+            ++line_;
+        }
+
+        string_begin_ = position;
+        string_decoded_ = false;
+        string_.clear();
+
+        const char* run = position;
+        bool non_ascii = false;
+        while(true)
+        {
+            position = string_scanner::find_special(position, end, quote, basic, non_ascii);
+            if(position == end)
+            {
+                throw parse_exception("unterminated string:" + line_text(start, end), line_);
+            }
+
+            if(*position == quote)
+            {
+                if(!multi_line)
+                {
+                    string_end_ = position;
+                    ++position;
+                    break;
+                }
+
+                const char* quotes_end = position;
+                while(quotes_end != end && *quotes_end == quote)
+                {
+                    ++quotes_end;
+                }
+
+                if(quotes_end - position >= 3)
+                {
+                    if(quotes_end - position > 5)
+                    {
+                        throw parse_exception("too many quotes at the end of string", line_);
+                    }
+
+                    string_end_ = quotes_end - 3;
+                    position = quotes_end;
+                    break;
+                }
+
+                position = quotes_end;
+            }
+            else if(*position == '\\')
+            {
+                string_.append(run, position);
+                string_decoded_ = true;
+                position = parse_escape(position, end, multi_line);
+                run = position;
+            }
+            else if(multi_line && *position == '\n')
+            {
+                ++line_;
+                ++position;
+            }
+            else if(multi_line && *position == '\r' && position + 1 != end && *(position + 1) == '\n')
+            {
+                ++line_;
+                position += 2;
+            }
+            else
+            {
+                const char* message = (*position == '\n' || *position == '\r') ? ("unterminated string:") : ("control character in string:");
+                throw parse_exception(message + line_text(start, end), line_);
+            }
+        }
+
+        if(non_ascii && !string_scanner::validate_utf8(string_begin_, string_end_))
+        {
+            throw parse_exception("invalid UTF-8 in string", line_);
+        }
+
+        if(string_decoded_)
+        {
+            string_.append(run, string_end_);
+        }
+
+        return position;
+    }
+
+    inline const char* parse_escape(const char* position, const char* end, bool multi_line)
+    {
+        if(++position == end)
+        {
+            throw parse_exception("unterminated string", line_);
+        }
+
+        switch(*position)
+        {
+        case 'b': string_ += '\b'; return position + 1;
+        case 't': string_ += '\t'; return position + 1;
+        case 'n': string_ += '\n'; return position + 1;
+        case 'f': string_ += '\f'; return position + 1;
+        case 'r': string_ += '\r'; return position + 1;
+        case '"': string_ += '"'; return position + 1;
+        case '\\': string_ += '\\'; return position + 1;
+        case 'u': return parse_unicode_escape(position + 1, end, 4);
+        case 'U': return parse_unicode_escape(position + 1, end, 8);
+        default:
+            break;
+        }
+
+        if(multi_line)
+        {
+            const char* line_end = consume_whitespace_toward_front(position, end);
+            if(line_end != end && (*line_end == '\n' || *line_end == '\r'))
+            {
+                while(line_end != end && (is_whitespace(*line_end) || *line_end == '\n' || *line_end == '\r'))
+                {
+                    line_ += (*line_end == '\n') ? (1) : (0);
+                    ++line_end;
+                }
+
+                return line_end;
+            }
+        }
+
+        throw parse_exception(std::string("illegal escape sequence:\\") + *position, line_);
+    }
+
+    inline const char* parse_unicode_escape(const char* position, const char* end, int digits)
+    {
+        if(end - position < digits)
+        {
+            throw parse_exception("unterminated string", line_);
+        }
+
+        uint32_t code_point = 0;
+        for(int i = 0; i < digits; ++i, ++position)
+        {
+            char c = *position;
+            code_point <<= 4;
+            if(is_number(c))
+            {
+                code_point |= c - '0';
+            }
+            else if('a' <= c && c <= 'f')
+            {
+                code_point |= c - 'a' + 10;
+            }
+            else if('A' <= c && c <= 'F')
+            {
+                code_point |= c - 'A' + 10;
+            }
+            else
+            {
+                throw parse_exception("illegal unicode escape", line_);
+            }
+        }
+
+        if(code_point > 0x10FFFF || (0xD800 <= code_point && code_point <= 0xDFFF))
+        {
+            throw parse_exception("unicode escape is not a scalar value", line_);
+        }
+
+        append_utf8(string_, code_point);
+        return position;
+    }
+
+    // Arrays and inline tables are tracked on containers_ instead of by
+    // recursion, so deeply nested values cost no native stack. depth counts
+    // the tables and arrays above the value being read.
+    inline const char* parse_value(const char* start, const char* end)
+    {
+        containers_.clear();
+        container_depths_.clear();
+        size_t depth = path_.size() + key_path_.size();
+
+        const char* position = start;
+        while(true)
+        {
+            if(position == end)
+            {
+                throw parse_exception("value is empty", line_);
+            }
+
+            if((*position == '[' || *position == '{') && depth >= max_depth_)
+            {
+                throw parse_exception("value is nested too deeply", line_);
+            }
+
+            if(*position == '[')
+            {
+                handler_.begin_array(range(position, position + 1));
+                containers_.push_back(']');
+                container_depths_.push_back(depth);
+                depth += 1;
+                position = skip_array_space(position + 1, end);
+                if(position == end || *position != ']')
+                {
+                    continue;
+                }
+            }
+            else if(*position == '{')
+            {
+                handler_.begin_inline_table(range(position, position + 1));
+                containers_.push_back('}');
+                container_depths_.push_back(depth);
+                position = consume_whitespace_toward_front(position + 1, end);
+                if(position == end || *position != '}')
+                {
+                    position = parse_key(position, end);
+                    depth += key_path_.size();
+                    continue;
+                }
+            }
+            else
+            {
+                position = parse_scalar(position, end);
+            }
+
+            bool next_value = false;
+            while(!containers_.empty() && !next_value)
+            {
+                char closing = containers_.back();
+                position = (closing == ']') ? (skip_array_space(position, end)) : (consume_whitespace_toward_front(position, end));
+
+                if(position != end && *position == closing)
+                {
+                    if(closing == ']')
+                    {
+                        handler_.end_array(range(position, position + 1));
+                    }
+                    else
+                    {
+                        handler_.end_inline_table(range(position, position + 1));
+                    }
+
+                    containers_.pop_back();
+                    container_depths_.pop_back();
+                    ++position;
+                    continue;
+                }
+
+                if(position == end || *position != ',')
+                {
+                    throw parse_exception(std::string("expected ',' or '") + closing + "':" + line_text(position, end), line_);
+                }
+                ++position;
+
+                if(closing == ']')
+                {
+                    // A trailing comma is allowed in arrays.
+                    position = skip_array_space(position, end);
+                    next_value = (position == end || *position != ']');
+                    depth = container_depths_.back() + 1;
+                }
+                else
+                {
+                    position = parse_key(consume_whitespace_toward_front(position, end), end);
+                    next_value = true;
+                    depth = container_depths_.back() + key_path_.size();
+                }
+            }
+
+            if(!next_value)
+            {
+                return position;
+            }
+        }
+    }
+
+    // Whitespace, newlines and comments between array elements.
+    inline const char* skip_array_space(const char* position, const char* end)
+    {
+        while(position != end)
+        {
+            if(*position == '\n')
+            {
+                ++line_;
+            }
+            else if(*position == '#')
+            {
+                auto newline = static_cast<const char*>(std::memchr(position, '\n', end - position));
+                if(newline == nullptr)
+                {
+                    return end;
+                }
+                position = newline;
+                continue;
+            }
+            else if(!is_whitespace(*position) && *position != '\r')
+            {
+                break;
+            }
+
+            ++position;
+        }
+
+        return position;
+    }
+
+    inline const char* parse_scalar(const char* start, const char* line_end)
+    {
+        parse_type type = value_type(start, line_end);
+
+        switch(type)
+        {
+        case parse_type::number:
+            return parse_number(start, line_end);
+            break;
+        case parse_type::string:
+            return parse_string_value(start, line_end);
+            break;
+        case parse_type::boolean:
+            return parse_boolean(start, line_end);
+            break;
+        case parse_type::date:
+            return parse_date(start, line_end);
+            break;
+        default:
+            break;
+        };
+
+        throw parse_exception("unsupported value:" + line_text(start, line_end), line_);
+    }
+
+    inline static parse_type value_type(const char* start, const char* line_end)
+    {
+        if((line_end - start > 4 && is_number(start[0]) && is_number(start[1]) && is_number(start[2]) && is_number(start[3]) && start[4] == '-') ||
+           (line_end - start > 2 && is_number(start[0]) && is_number(start[1]) && start[2] == ':'))
+        {
+            return parse_type::date;
+        }
+
+        if(is_number(*start) || *start == '+' || *start == '-' || *start == 'i' || *start == 'n')
+        {
+            return parse_type::number;
+        }
+
+        if(*start == '"' || *start == '\'')
+        {
+            return parse_type::string;
+        }
+
+        if(*start == 't' || *start == 'f')
+        {
+            return parse_type::boolean;
+        }
+
+        return parse_type::error;
+    }
+
+    inline const char* parse_string_value(const char* start, const char* end)
+    {
+        const char* position = parse_string(start, end);
+        if(string_decoded_)
+        {
+            handler_.string(string_.data(), string_.size(), range(start, position));
+        }
+        else
+        {
+            handler_.string(string_begin_, string_end_ - string_begin_, range(start, position));
+        }
+
+        return position;
+    }
+
+    inline const char* parse_boolean(const char* start, const char* line_end)
+    {
+        if(line_end - start >= 4 && std::memcmp(start, "true", 4) == 0)
+        {
+            handler_.boolean(true, range(start, start + 4));
+            return start + 4;
+        }
+
+        if(line_end - start >= 5 && std::memcmp(start, "false", 5) == 0)
+        {
+            handler_.boolean(false, range(start, start + 5));
+            return start + 5;
+        }
+
+        throw parse_exception("unsupported value:" + line_text(start, line_end), line_);
+    }
+
+    inline const char* parse_number(const char* start, const char* line_end)
+    {
+        const char* number_end = start;
+        if(*start == '+' || *start == '-')
+        {
+            ++number_end;
+        }
+
+        if(line_end - number_end >= 3 && (std::memcmp(number_end, "inf", 3) == 0 || std::memcmp(number_end, "nan", 3) == 0))
+        {
+            number_end += 3;
+            handler_.floating(std::strtod(std::string(start, number_end).c_str(), nullptr), range(start, number_end));
+            return number_end;
+        }
+
+        if(number_end == start && line_end - start > 2 && start[0] == '0' && (start[1] == 'x' || start[1] == 'o' || start[1] == 'b'))
+        {
+            return parse_radix_integer(start, line_end);
+        }
+
+        const char* integer_start = number_end;
+        number_end = consume_digits(number_end, start, line_end);
+        if(*integer_start == '0' && number_end - integer_start > 1)
+        {
+            throw parse_exception("leading zero in number:" + line_text(start, line_end), line_);
+        }
+
+        bool integer = true;
+        if(number_end != line_end && *number_end == '.')
+        {
+            integer = false;
+            number_end = consume_digits(number_end + 1, start, line_end);
+        }
+
+        if(number_end != line_end && (*number_end == 'e' || *number_end == 'E'))
+        {
+            integer = false;
+            ++number_end;
+            if(number_end != line_end && (*number_end == '+' || *number_end == '-'))
+            {
+                ++number_end;
+            }
+            number_end = consume_digits(number_end, start, line_end);
+        }
+
+        number_.assign(start, number_end);
+        number_.erase(std::remove(number_.begin(), number_.end(), '_'), number_.end());
+
+        errno = 0;
+        if(!integer)
+        {
+            handler_.floating(std::strtod(number_.c_str(), nullptr), range(start, number_end));
+            return number_end;
+        }
+
+        long long value = std::strtoll(number_.c_str(), nullptr, 10);
+        if(errno == ERANGE)
+        {
+            throw parse_exception("integer out of range:" + number_, line_);
+        }
+
+        handler_.integer(value, range(start, number_end));
+        return number_end;
+    }
+
+    // 0x, 0o and 0b integers; TOML allows no sign on them.
+    inline const char* parse_radix_integer(const char* start, const char* line_end)
+    {
+        int radix = (start[1] == 'x') ? (16) : ((start[1] == 'o') ? (8) : (2));
+        auto digit = [radix](char c)
+        {
+            int value = (is_number(c)) ? (c - '0') : ((('a' <= c && c <= 'f') || ('A' <= c && c <= 'F')) ? ((c | 0x20) - 'a' + 10) : (radix));
+            return (value < radix) ? (value) : (-1);
+        };
+
+        number_.clear();
+        const char* position = start + 2;
+        for(; position != line_end; ++position)
+        {
+            if(*position == '_' && !number_.empty() && position + 1 != line_end && digit(position[1]) >= 0)
+            {
+                continue;
+            }
+
+            if(digit(*position) < 0)
+            {
+                break;
+            }
+            number_ += *position;
+        }
+
+        if(number_.empty())
+        {
+            throw parse_exception("illegal format exception:" + line_text(start, line_end), line_);
+        }
+
+        errno = 0;
+        unsigned long long value = std::strtoull(number_.c_str(), nullptr, radix);
+        if(errno == ERANGE || value > static_cast<unsigned long long>(std::numeric_limits<int64_t>::max()))
+        {
+            throw parse_exception("integer out of range:" + std::string(start, position), line_);
+        }
+
+        handler_.integer(static_cast<int64_t>(value), range(start, position));
+        return position;
+    }
+
+    // Digits, with single underscores allowed between them.
+    inline const char* consume_digits(const char* position, const char* start, const char* line_end)
+    {
+        if(position == line_end || !is_number(*position))
+        {
+            std::string error = "illegal format exception:" + line_text(start, line_end);
+            throw parse_exception(error, line_);
+        }
+
+        ++position;
+        while(position != line_end)
+        {
+            if(*position == '_' && position + 1 != line_end && is_number(*(position + 1)))
+            {
+                position += 2;
+            }
+            else if(is_number(*position))
+            {
+                ++position;
+            }
+            else
+            {
+                break;
+            }
+        }
+
+        return position;
+    }
+
+    // Accepts the four RFC 3339 forms TOML allows; digits after milliseconds are dropped.
+    inline const char* parse_date(const char* start, const char* line_end)
+    {
+        const char* position = start;
+        date_time result;
+
+        if(start[2] == ':')
+        {
+            int32_t hour, minute, second, millisecond;
+            position = parse_time(position, line_end, hour, minute, second, millisecond);
+            result = date_time::local_time(hour, minute, second, millisecond);
+        }
+        else
+        {
+            int32_t year = parse_digits(position, line_end, 4);
+            expect(position, line_end, '-');
+            int32_t month = parse_digits(position, line_end, 2);
+            expect(position, line_end, '-');
+            int32_t day = parse_digits(position, line_end, 2);
+            if(!date_time::is_valid_date(year, month, day))
+            {
+                throw parse_exception("illegal date:" + std::string(start, position), line_);
+            }
+
+            bool has_time = (position != line_end) && (*position == 'T' || *position == 't' ||
+                            (*position == ' ' && line_end - position > 3 && is_number(position[1]) && position[3] == ':'));
+            if(!has_time)
+            {
+                result = date_time::local_date(year, month, day);
+            }
+            else
+            {
+                int32_t hour, minute, second, millisecond;
+                position = parse_time(position + 1, line_end, hour, minute, second, millisecond);
+
+                if(position != line_end && (*position == 'Z' || *position == 'z'))
+                {
+                    ++position;
+                    result = date_time::offset_date_time(year, month, day, hour, minute, second, millisecond, 0);
+                }
+                else if(position != line_end && (*position == '+' || *position == '-'))
+                {
+                    int32_t sign = (*(position++) == '-') ? (-1) : (1);
+                    int32_t offset_hour = parse_digits(position, line_end, 2);
+                    expect(position, line_end, ':');
+                    int32_t offset_minute = parse_digits(position, line_end, 2);
+                    if(offset_hour > 23 || offset_minute > 59)
+                    {
+                        throw parse_exception("illegal offset:" + std::string(start, position), line_);
+                    }
+
+                    result = date_time::offset_date_time(year, month, day, hour, minute, second, millisecond,
+                                                         sign * (offset_hour * 60 + offset_minute));
+                }
+                else
+                {
+                    result = date_time::local_date_time(year, month, day, hour, minute, second, millisecond);
+                }
+            }
+        }
+
+        handler_.date(result, range(start, position));
+        return position;
+    }
+
+    inline const char* parse_time(const char* position, const char* line_end, int32_t& hour, int32_t& minute, int32_t& second, int32_t& millisecond)
+    {
+        const char* start = position;
+        hour = parse_digits(position, line_end, 2);
+        expect(position, line_end, ':');
+        minute = parse_digits(position, line_end, 2);
+        expect(position, line_end, ':');
+        second = parse_digits(position, line_end, 2);
+        if(hour > 23 || minute > 59 || second > 60)
+        {
+            throw parse_exception("illegal time:" + std::string(start, position), line_);
+        }
+
+        millisecond = 0;
+        if(position != line_end && *position == '.')
+        {
+            ++position;
+            const char* fraction = position;
+            while(position != line_end && is_number(*position))
+            {
+                if(position - fraction < 3)
+                {
+                    millisecond = millisecond * 10 + (*position - '0');
+                }
+                ++position;
+            }
+
+            if(position == fraction)
+            {
+                throw parse_exception("illegal time:" + std::string(start, position), line_);
+            }
+
+            for(auto digits = position - fraction; digits < 3; ++digits)
+            {
+                millisecond *= 10;
+            }
+        }
+
+        return position;
+    }
+
+    inline int32_t parse_digits(const char*& position, const char* line_end, int count)
+    {
+        int32_t result = 0;
+        for(int i = 0; i < count; ++i, ++position)
+        {
+            if(position == line_end || !is_number(*position))
+            {
+                throw parse_exception("illegal date time format", line_);
+            }
+            result = result * 10 + (*position - '0');
+        }
+
+        return result;
+    }
+
+    inline void expect(const char*& position, const char* line_end, char c)
+    {
+        if(position == line_end || *position != c)
+        {
+            throw parse_exception(std::string("expected '") + c + "' in date time", line_);
+        }
+        ++position;
+    }
+
+    inline static std::string line_text(const char* start, const char* end)
+    {
+        auto line_end = static_cast<const char*>(std::memchr(start, '\n', end - start));
+        return std::string(start, (line_end != nullptr) ? (line_end) : (end));
+    }
+
+    inline source_range range(const char* start, const char* end) const
+    {
+        source_range result;
+        result.begin = position_ + (start - statement_start_);
+        result.end = position_ + (end - statement_start_);
+        result.line = line_;
+        return result;
+    }
+
+    inline static const char* consume_whitespace_toward_front(const char* start, const char* end)
+    {
+        const char* result = start;
+        while(result != end && is_whitespace(*result))
+        {
+            ++result;
+        }
+
+        return result;
+    }
+
+    inline static const char* consume_whitespace_toward_back(const char* end, const char* start)
+    {
+        const char* result = end;
+        while(result != start && is_whitespace(*(result - 1)))
+        {
+            --result;
+        }
+
+        return result;
+    }
+
+    inline static bool is_whitespace(char c)
+    {
+        return (c == ' ' || c == '\t');
+    }
+
+    inline static bool is_number(char c)
+    {
+        return ('0' <= c && c <= '9');
+    }
+
+    inline static bool is_bare_key(char c)
+    {
+        return ('A' <= c && c <= 'Z') || ('a' <= c && c <= 'z') || is_number(c) || c == '_' || c == '-';
+    }
+
+private:
+    handler_type& handler_;
+    std::string carry_;
+    statement_scan scan_;
+    std::vector<std::string> key_path_;
+    std::vector<char> containers_;
+    std::vector<size_t> container_depths_;
+    std::string number_;
+    std::string string_;
+    const char* string_begin_;
+    const char* string_end_;
+    bool string_decoded_;
+    std::vector<std::string> path_;
+    const char* statement_start_;
+    size_t position_;
+    unsigned int line_;
+    size_t max_depth_;
+};
+
+class push_parser
+{
+public:
+    push_parser() : parser_(builder_)
+    {}
+
+    inline void feed(const char* data, size_t size)
+    {
+        parser_.feed(data, size);
+    }
+
+    inline void feed(const std::string& data)
+    {
+        parser_.feed(data);
+    }
+
+    inline table finish()
+    {
+        parser_.finish();
+        parser_.reset();
+        return builder_.release();
+    }
+
+    // Parses a whole document without copying it to the carry-over buffer.
+    inline table parse(const char* data, size_t size)
+    {
+        parser_.parse(data, size);
+        parser_.reset();
+        return builder_.release();
+    }
+
+    inline void reset()
+    {
+        parser_.reset();
+        builder_.reset();
+    }
+
+    inline size_t carry_size() const
+    {
+        return parser_.carry_size();
+    }
+
+    inline void set_max_depth(size_t max_depth)
+    {
+        parser_.set_max_depth(max_depth);
+    }
+
+private:
+    table_builder builder_;
+    basic_push_parser<table_builder> parser_;
+};
+
+// Walks one array of tables ([[path]]) or one array value (path = [...]) of
+// a document held in memory, such as a mapped file, one element at a time.
+// Only the element being looked at is built, into scratch tables that are
+// reused; the rest of the document is built into document() as the cursor
+// passes it.
+class record_cursor
+{
+public:
+    using path_type = std::vector<std::string>;
+
+    // Strings without escape sequences are views into data, which must
+    // outlive the cursor and every value taken from it.
+    record_cursor(const char* data, size_t size, path_type path) :
+        position_(data),
+        end_(data + size),
+        router_(data, size, std::move(path)),
+        parser_(router_),
+        in_array_(false)
+    {}
+
+    record_cursor(const record_cursor&) = delete;
+    record_cursor& operator = (const record_cursor&) = delete;
+
+    // Parses up to the end of the next element; false at the end of the
+    // input. The previous element is no longer valid afterwards.
+    inline bool next()
+    {
+        router_.release_ready();
+
+        while(!router_.has_ready())
+        {
+            if(in_array_)
+            {
+                next_array_element();
+                continue;
+            }
+
+            if(position_ == end_)
+            {
+                return router_.finish();
+            }
+
+            next_statement();
+        }
+
+        return true;
+    }
+
+    // The current [[path]] table, or the current element of path = [...].
+    inline base& value()
+    {
+        return router_.value();
+    }
+
+    // Everything outside path read so far; complete once next() has
+    // returned false. A path = [...] is in it as an empty array.
+    inline table& document()
+    {
+        return router_.document();
+    }
+
+    inline unsigned int line() const
+    {
+        return parser_.line();
+    }
+
+private:
+    class router
+    {
+    public:
+        router(const char* data, size_t size, path_type path) :
+            data_(data),
+            size_(size),
+            path_(std::move(path)),
+            mode_(mode::document),
+            ready_mode_(mode::document),
+            matched_(false),
+            nesting_(0),
+            found_array_(false),
+            found_tables_(false),
+            active_(0),
+            ready_(none)
+        {
+            document_.set_source(data_, size_);
+        }
+
+        inline void table_header(const path_type& path, const source_range& range)
+        {
+            if(path == path_)
+            {
+                throw parse_exception("key is not an array of tables:" + path.back(), range.line);
+            }
+
+            if(mode_ == mode::record && is_below(path))
+            {
+                builders_[active_].table_header(path_type(path.begin() + path_.size(), path.end()), range);
+                return;
+            }
+
+            end_record();
+            header_path_ = path;
+            document_.table_header(path, range);
+        }
+
+        inline void array_table_header(const path_type& path, const source_range& range)
+        {
+            if(path == path_)
+            {
+                if(found_array_)
+                {
+                    throw parse_exception("key is not an array of tables:" + path.back(), range.line);
+                }
+
+                found_tables_ = true;
+                end_record();
+                begin_scratch();
+                mode_ = mode::record;
+                return;
+            }
+
+            if(mode_ == mode::record && is_below(path))
+            {
+                builders_[active_].array_table_header(path_type(path.begin() + path_.size(), path.end()), range);
+                return;
+            }
+
+            end_record();
+            header_path_ = path;
+            document_.array_table_header(path, range);
+        }
+
+        inline void key(const path_type& path, const source_range& range)
+        {
+            // Keys inside inline tables and arrays are not path, whatever
+            // their name.
+            if(mode_ == mode::document && nesting_ == 0 && header_path_.size() + path.size() == path_.size() &&
+                    std::equal(header_path_.begin(), header_path_.end(), path_.begin()) &&
+                    std::equal(path.begin(), path.end(), path_.begin() + header_path_.size()))
+            {
+                if(found_tables_)
+                {
+                    throw parse_exception("duplicate key:" + path.back(), range.line);
+                }
+
+                // An empty array stands in for the elements, so that the
+                // document still rejects anything else defining path.
+                document_.key(path, range);
+                document_.begin_array(range);
+                document_.end_array(range);
+                found_array_ = true;
+                matched_ = true;
+                return;
+            }
+
+            sink().key(path, range);
+        }
+
+        inline void integer(int64_t value, const source_range& range)
+        {
+            sink().integer(value, range);
+        }
+
+        inline void floating(double value, const source_range& range)
+        {
+            sink().floating(value, range);
+        }
+
+        inline void string(const char* data, size_t size, const source_range& range)
+        {
+            sink().string(data, size, range);
+        }
+
+        inline void boolean(bool value, const source_range& range)
+        {
+            sink().boolean(value, range);
+        }
+
+        inline void date(const date_time& value, const source_range& range)
+        {
+            sink().date(value, range);
+        }
+
+        inline void begin_array(const source_range& range)
+        {
+            ++nesting_;
+            sink().begin_array(range);
+        }
+
+        inline void end_array(const source_range& range)
+        {
+            --nesting_;
+            sink().end_array(range);
+        }
+
+        inline void begin_inline_table(const source_range& range)
+        {
+            ++nesting_;
+            sink().begin_inline_table(range);
+        }
+
+        inline void end_inline_table(const source_range& range)
         {
-          stream << ',';
+            --nesting_;
+            sink().end_inline_table(range);
         }
-      }
 
-      stream << ']';
-    }
-};
+        // True once, right after the key path = was read.
+        inline bool take_match()
+        {
+            bool matched = matched_;
+            matched_ = false;
+            return matched;
+        }
 
-class table : public value<std::unordered_map<std::string, std::shared_ptr<base>>, base::data_type::table>
-{
-public:
-    using base_type = value<std::unordered_map<std::string, std::shared_ptr<base>>, base::data_type::table>;
-    using container_type = typename base_type::value_type;
-        
-    using iterator = typename container_type::iterator;
-    using const_iterator = typename container_type::const_iterator;
+        inline void end_statement()
+        {
+            matched_ = false;
+            nesting_ = 0;
+        }
 
-    table() = default;
+        // The elements of path = [...] are each built as the value of
+        // element_key in a scratch table.
+        inline void begin_element(unsigned int line)
+        {
+            begin_scratch();
+            mode_ = mode::element;
+            builders_[active_].key(path_type(1, element_key()), source_range{0, 0, line});
+        }
 
-    table(const std::unordered_map<std::string, std::shared_ptr<base>>& other) : base_type(other)
-    {}
+        inline void end_element()
+        {
+            end_record();
+        }
 
-    table(std::unordered_map<std::string, std::shared_ptr<base>>&& other) : base_type(std::move(other))
-    {}
+        inline bool finish()
+        {
+            end_record();
+            return has_ready();
+        }
 
-    inline bool has(const std::string& key)
-    {
-        auto find_result = data_.find(key);
-        return find_result != data_.end();
-    }
+        inline bool has_ready() const
+        {
+            return ready_ != none;
+        }
 
-    template<class value_data>
-    inline bool add(const std::string& key, const value_data& value)
-    {
-        auto value_ptr = std::make_shared<value_data>(value);
-        auto result = data_.emplace(key, std::static_pointer_cast<base>(value_ptr));
-        return result.second;
-    }
+        inline void release_ready()
+        {
+            ready_ = none;
+        }
 
-    template<class value_data>
-    inline bool add(const std::string& key, std::shared_ptr<value_data> value)
-    {
-        auto result = data_.emplace(key, std::static_pointer_cast<base>(value));
-        return result.second;
-    }
+        inline base& value()
+        {
+            table& root = builders_[ready_].root();
+            if(ready_mode_ == mode::record)
+            {
+                return root;
+            }
 
-    inline bool add(const std::string& key, const int& value)
-    {
-        return add(key, int_value(value));
-    }
+            return *root[element_key()];
+        }
 
-    inline bool add(const std::string& key, const float& value)
-    {
-        return add(key, float_value(value));
-    }
+        inline table& document()
+        {
+            return document_.root();
+        }
 
-    inline bool add(const std::string& key, const std::string& value)
-    {
-        return add(key, string_value(value));
-    }
+    private:
+        enum class mode
+        {
+            document,
+            record,
+            element
+        };
 
-    inline bool add(const std::string& key, const bool& value)
-    {
-        return add(key, bool_value(value));
-    }
+        static const size_t none = static_cast<size_t>(-1);
 
-    inline bool add(const std::string& key, const date_time& value)
-    {
-        return add(key, date_time_value(value));
-    }
-   
-    template<class value_data>
-    inline std::shared_ptr<value_data> get_as(const std::string& key)
-    {
-        if(!has(key))
+        inline static const std::string& element_key()
         {
+            static const std::string key("element");
+            return key;
+        }
 
-            return nullptr;
+        inline bool is_below(const path_type& path) const
+        {
+            return path.size() > path_.size() && std::equal(path_.begin(), path_.end(), path.begin());
         }
 
-        std::shared_ptr<base> base_type_value = data_[key];
-        return std::dynamic_pointer_cast<value_data>(base_type_value);
-    }
+        inline table_builder& sink()
+        {
+            return (mode_ == mode::document) ? (document_) : (builders_[active_]);
+        }
 
-    template<class value_data>
-    inline std::vector<std::shared_ptr<value_data>> get_as(const std::string& key)
-    {
-        if(!has(key))
+        // Two scratch builders take turns: the [[path]] header that starts
+        // the next table is also what ends the one being handed out.
+        inline void begin_scratch()
         {
-            return nullptr;
+            active_ ^= 1;
+            builders_[active_].reset();
+            builders_[active_].set_source(data_, size_);
         }
 
-        std::shared_ptr<array> array_type_value = std::dynamic_pointer_cast<array>(data_[key]);
-        return array_type_value->get_array_as<value_data>();
+        inline void end_record()
+        {
+            if(mode_ != mode::document)
+            {
+                ready_ = active_;
+                ready_mode_ = mode_;
+                mode_ = mode::document;
+            }
+        }
 
-    }
+    private:
+        const char* data_;
+        size_t size_;
+        path_type path_;
+        path_type header_path_;
+        mode mode_;
+        mode ready_mode_;
+        bool matched_;
+        size_t nesting_;
+        bool found_array_;
+        bool found_tables_;
+        table_builder document_;
+        table_builder builders_[2];
+        size_t active_;
+        size_t ready_;
+    };
 
-    template<class data_type>
-    inline std::shared_ptr<data_type> create(const std::string& key)
+    inline void next_statement()
     {
-        if(has(key))
+        const char* position = position_;
+        while(position != end_ && (*position == ' ' || *position == '\t'))
         {
-            return nullptr;
+            ++position;
         }
 
-        auto new_data = std::make_shared<data_type>();
-        add(key, new_data);
+        if(position == end_ || *position == '[' || *position == '#' || *position == '\n' || *position == '\r')
+        {
+            position_ = parser_.parse_next_statement(position_, end_);
+            router_.end_statement();
+            return;
+        }
 
-        return new_data;
-    }
+        position_ = parser_.parse_next_key(position_, end_);
+        if(!router_.take_match())
+        {
+            position_ = parser_.parse_next_value(position_, end_);
+            position_ = parser_.parse_next_line_end(position_, end_);
+            router_.end_statement();
+            return;
+        }
 
-    inline std::shared_ptr<base> operator[](const std::string& key)
-    {
-        return data_.at(key);
+        bool closed = false;
+        position_ = parser_.parse_next_array_open(position_, end_, closed);
+        in_array_ = !closed;
+        if(closed)
+        {
+            position_ = parser_.parse_next_line_end(position_, end_);
+        }
     }
 
-    inline std::shared_ptr<base> operator[](const std::string& key) const
+    inline void next_array_element()
     {
-        return data_.at(key);
-    }
+        router_.begin_element(parser_.line());
+        position_ = parser_.parse_next_value(position_, end_);
+        router_.end_element();
 
-    inline iterator begin()
-    {
-        return data_.begin();
+        bool closed = false;
+        position_ = parser_.parse_next_array_separator(position_, end_, closed);
+        if(closed)
+        {
+            in_array_ = false;
+            position_ = parser_.parse_next_line_end(position_, end_);
+        }
     }
 
-    inline iterator end()
-    {
-        return data_.end();
-    }
+private:
+    const char* position_;
+    const char* end_;
+    router router_;
+    basic_push_parser<router> parser_;
+    bool in_array_;
+};
 
-    inline const_iterator begin() const
-    {
-        return data_.begin();
-    }
+// Joins its threads when it goes out of scope, so that an exception thrown
+// while they run, or while starting one of them, does not destroy a
+// joinable std::thread.
+class thread_joiner
+{
+public:
+    thread_joiner() = default;
 
-    inline const_iterator end() const
+    thread_joiner(const thread_joiner&) = delete;
+    thread_joiner& operator = (const thread_joiner&) = delete;
+
+    ~thread_joiner()
     {
-        return data_.end();
+        join();
     }
 
-    virtual inline void accept(std::ostream& stream) override
+    template<class function>
+    inline void start(unsigned int count, const function& work)
     {
-      std::ostringstream child_stream;
-      for(auto& i : data_)
-      {
-        if((*i.second).is<table>())
+        threads_.reserve(threads_.size() + count);
+        for(unsigned int i = 0; i < count; ++i)
         {
-          std::dynamic_pointer_cast<table>(i.second)->accept(child_stream, i.first);
-          stream << child_stream.str();
+            threads_.emplace_back(work);
         }
-        else
-        {
-          stream << i.first << " = " << (*i.second) << std::endl;
-        }
-      }
     }
 
-    inline void accept(std::ostream& stream, const std::string& table_name)
+    inline void join()
     {
-      std::ostringstream child_stream;
-
-      bool has_value = false;
-      for(auto& i : data_)
-      {
-        if((*i.second).is<table>())
-        {
-          std::ostringstream child_table_name_stream;
-          child_table_name_stream << table_name << "." << i.first;
-          std::string child_table_name = child_table_name_stream.str();
-
-          std::ostringstream child_element_stream;
-          std::dynamic_pointer_cast<table>(i.second)->accept(child_element_stream, child_table_name);
-          child_stream << child_element_stream.str();
-        }
-        else
+        for(auto& thread : threads_)
         {
-          if(!has_value)
-          {
-            stream << "[" << table_name << "]" << std::endl;
-            has_value = true;
-          }
-
-          stream << i.first << " = " << (*i.second) << std::endl;
+            if(thread.joinable())
+            {
+                thread.join();
+            }
         }
-      }
-
-      stream << child_stream.str();
+        threads_.clear();
     }
+
+private:
+    std::vector<std::thread> threads_;
 };
 
-class parse_exception : public std::runtime_error
+struct parse_result
 {
-public:
-    parse_exception(const std::string& message) : std::runtime_error(message)
+    parse_result() : success(false)
     {}
 
-    parse_exception(const std::string& message, unsigned int line) : std::runtime_error(message + " at line " + std::to_string(line))
-    {}
+    table document;
+    bool success;
+    std::string error;
 };
 
 class parse
 {
-private:
-    enum class parse_type
-    {
-        error,
-        number,
-        string,
-        boolean,
-        date,
-        array,
-        table 
-    };
-
 public:
     inline static table parse_str(const std::string& str)
     {
-        std::istringstream stream = std::istringstream(str);
-        return parse_impl(stream);
-    }
-
-private:
-    inline static table parse_impl(std::istream& stream)
-    {
-        table root;
-        std::string line;
-        while(std::getline(stream, line))
-        {
-            std::cout << __FILE__ << "::" << __LINE__ << "  " << line << std::endl;
-            parse_key_valeu_pair(root, line.begin(), line.end());
-        }
-
-        return root;
+        table_builder builder;
+        basic_push_parser<table_builder> parser(builder);
+        parser.parse(str.data(), str.size());
+        return builder.release();
     }
 
-    inline static void parse_key_valeu_pair(table& table, const std::string::iterator& line_start, const std::string::iterator& line_end)
+    // Strings without escape sequences are views into data, which must
+    // outlive the returned table and every value taken from it.
+    inline static table parse_view(const char* data, size_t size)
     {
-        auto key_start = consume_whitespace_toward_front(line_start, line_end);
-        if(key_start == line_end || *key_start == '#')
-        {
-            return;
-        }
-
-        std::string::iterator value_start;
-        std::string key = parse_key(value_start, key_start, line_end);
-
-        std::cout << __FILE__ << "::" << __LINE__ << "  key=" << key << std::endl;
-
-        value_start = consume_whitespace_toward_front(value_start, line_end);
-        auto value = parse_value(value_start, line_end);
-
-        std::cout << key << std::endl;
-        table.add(key, value);;
+        table_builder builder;
+        builder.set_source(data, size);
+        basic_push_parser<table_builder> parser(builder);
+        parser.parse(data, size);
+        return builder.release();
     }
 
-    inline static std::string parse_key(std::string::iterator& value_start, const std::string::iterator& start, const std::string::iterator& line_end)
+    // Documents are handed out to the workers one at a time, so a few large
+    // files do not leave the other threads idle. Results keep the input order.
+    inline static std::vector<parse_result> parse_many(const std::vector<std::string>& buffers, unsigned int thread_count = 0)
     {
-        auto equal = std::find_if(start, line_end, [](char c){ return c == '='; });
-        auto key_end = equal - 1;
-        key_end = consume_whitespace_toward_back(key_end, start);
-
-        if(start == key_end)
-        {
-            std::cout << "=" << std::endl;
-            std::cout << "TODO: thow exception" << std::endl;
-        }
-
-        std::string key(start, key_end);
-
-        value_start = equal + 1;
-        return key;
+        return parse_many_impl(buffers.size(), thread_count,
+                [&](size_t index, scratch& worker)
+                {
+                    return worker.parser.parse(buffers[index].data(), buffers[index].size());
+                });
     }
 
-    inline static std::shared_ptr<base> parse_value(const std::string::iterator& start, const std::string::iterator& line_end)
+    inline static std::vector<parse_result> parse_many_files(const std::vector<std::string>& paths, unsigned int thread_count = 0)
     {
-        parse_type type = value_type(start);
-
-        switch(type)
-        {
-        case parse_type::number:
-            return parse_number(start, line_end);
-            break;
-        case parse_type::string:
-            break;
-        case parse_type::boolean:
-            break;
-        case parse_type::date:
-            break;
-        case parse_type::array:
-            break;
-        case parse_type::table:
-            break;
-        default:
-            break;
-        };
-
-        return std::static_pointer_cast<base>(std::make_shared<int_value>(10000000000));
+        return parse_many_impl(paths.size(), thread_count,
+                [&](size_t index, scratch& worker)
+                {
+                    read_file(paths[index], worker.source);
+                    return worker.parser.parse(worker.source.data(), worker.source.size());
+                });
     }
 
-    inline static parse_type value_type(const std::string::iterator& start)
+private:
+    struct scratch
     {
-        if(is_number(*start) || *start == '+' || *start == '-')
-        {
-            return parse_type::number;
-        }
-
-        // TODO: thow exception
-        return parse_type::error;
-    }
+        std::string source;
+        push_parser parser;
+    };
 
-    inline static std::shared_ptr<base> parse_number(const std::string::iterator& start, const std::string::iterator& line_end)
+    template<class parse_function>
+    inline static std::vector<parse_result> parse_many_impl(size_t count, unsigned int thread_count, const parse_function& parse_document)
     {
-        bool integer = true;
-        std::string::iterator number_end = start;
-        if(*start == '+' || *start == '-')
-        {
-            ++number_end;
-        }
+        std::vector<parse_result> results(count);
+        std::atomic<size_t> next_index(0);
 
-        bool first = true;
-        while(number_end != line_end && *number_end != ' ' && *number_end != '\t' && *number_end != '#')
+        auto worker = [&]()
         {
-            if(!is_number(*number_end))
+            scratch buffers;
+            for(size_t index = next_index++; index < count; index = next_index++)
             {
-                if(!first && (*number_end == '.' || *number_end == '_'))
+                try
                 {
-                    ++number_end;
-                    if(is_number(*number_end))
-                    {
-                        first = false;
-                        ++number_end;
-                        continue;
-                    }
-                    else
-                    {
-                        std::string error = "illegal format exception:" + std::string(start, line_end);
-                        throw parse_exception(error);
-                    }
+                    results[index].document = parse_document(index, buffers);
+                    results[index].success = true;
                 }
-                else
+                catch(const std::exception& e)
                 {
-                    std::string error = "illegal format exception:" + std::string(start, line_end);
-                    throw parse_exception(error);
+                    buffers.parser.reset();
+                    results[index].error = e.what();
                 }
-                break;
-            } 
-            first = false;
-            ++number_end;
-        }
+            }
+        };
 
-        std::string number(start, number_end);
-        number.erase(std::remove(number.begin(), number.end(), '_'), number.end());
-        if(integer)
+        if(thread_count == 0)
         {
-            auto value = stoi(number);
-            std::cout << __FILE__ << "::" << __LINE__ << "  " << value << std::endl;
-            return std::static_pointer_cast<base>(std::make_shared<int_value>(value));
+            thread_count = std::max(std::thread::hardware_concurrency(), 1u);
         }
+        thread_count = static_cast<unsigned int>(std::min<size_t>(thread_count, std::max<size_t>(count, 1)));
 
-        std::cout << __FILE__ << "::" << __LINE__ << "  " << std::string(start, number_end) << std::endl;
-        return std::static_pointer_cast<base>(std::make_shared<int_value>(100));
-    }
-
-    inline static std::string::iterator consume_whitespace_toward_front(const std::string::iterator& start, const std::string::iterator& end)
-    {
-        std::string::iterator result = start;
-        while (result != end && (*result == ' ' || *result == '\t'))
-        {
-            ++result;
-        }
+        thread_joiner threads;
+        threads.start(thread_count - 1, worker);
+        worker();
+        threads.join();
 
-        return result;
+        return results;
     }
 
-    inline static std::string::iterator consume_whitespace_toward_back(const std::string::iterator& end, const std::string::iterator& start)
+    inline static void read_file(const std::string& path, std::string& buffer)
     {
-        std::string::iterator result = end;
-        while (result != start && (*result == ' ' || *result == '\t'))
+        std::ifstream stream(path, std::ios::in | std::ios::binary);
+        if(!stream)
         {
-            --result;
+            throw parse_exception("can not open file:" + path);
         }
-        ++result;
-
-        return result;
-    }
 
-    inline static bool is_number(char c)
-    {
-        return ('0' <= c && c <= '9');
+        stream.seekg(0, std::ios::end);
+        buffer.resize(static_cast<size_t>(stream.tellg()));
+        stream.seekg(0, std::ios::beg);
+        stream.read(&buffer[0], buffer.size());
     }
 };
 
@@ -0,0 +1,564 @@
+#ifndef __TOML_DOCUMENT_HPP__
+#define __TOML_DOCUMENT_HPP__
+
+#include "toml.hpp"
+
+#include <map>
+#include <set>
+
+namespace toml
+{
+
+// Handler of basic_push_parser that builds the table tree and remembers
+// where each key/value line and each table's last line are in the source.
+class document_index
+{
+public:
+    using path_type = std::vector<std::string>;
+
+    struct entry
+    {
+        size_t line_begin;
+        size_t value_begin;
+        size_t value_end;
+        size_t line_end;
+    };
+
+    document_index(const char* data, size_t size) : data_(data), size_(size), key_begin_(0), value_begin_(0), depth_(0), in_table_array_(false)
+    {
+        sections_[path_] = 0;
+    }
+
+    document_index(const document_index&) = delete;
+    document_index& operator = (const document_index&) = delete;
+
+    inline void table_header(const path_type& path, const source_range& range)
+    {
+        builder_.table_header(path, range);
+        path_ = path;
+
+        // Tables inside an array of tables have no path of their own.
+        in_table_array_ = false;
+        for(size_t i = 1; i <= path.size() && !in_table_array_; ++i)
+        {
+            in_table_array_ = table_arrays_.count(path_type(path.begin(), path.begin() + i)) != 0;
+        }
+
+        if(!in_table_array_)
+        {
+            sections_[path_] = line_end(range.end);
+        }
+    }
+
+    inline void array_table_header(const path_type& path, const source_range& range)
+    {
+        builder_.array_table_header(path, range);
+        path_ = path;
+        table_arrays_.insert(path);
+        in_table_array_ = true;
+    }
+
+    inline void key(const path_type& path, const source_range& range)
+    {
+        builder_.key(path, range);
+        if(depth_ == 0)
+        {
+            key_path_ = path;
+            key_begin_ = range.begin;
+        }
+    }
+
+    inline void integer(int64_t value, const source_range& range)
+    {
+        builder_.integer(value, range);
+        add_entry(range.begin, range.end);
+    }
+
+    inline void floating(double value, const source_range& range)
+    {
+        builder_.floating(value, range);
+        add_entry(range.begin, range.end);
+    }
+
+    inline void string(const char* data, size_t size, const source_range& range)
+    {
+        builder_.string(data, size, range);
+        add_entry(range.begin, range.end);
+    }
+
+    inline void boolean(bool value, const source_range& range)
+    {
+        builder_.boolean(value, range);
+        add_entry(range.begin, range.end);
+    }
+
+    inline void date(const date_time& value, const source_range& range)
+    {
+        builder_.date(value, range);
+        add_entry(range.begin, range.end);
+    }
+
+    // An array or inline table is indexed as one value.
+    inline void begin_array(const source_range& range)
+    {
+        builder_.begin_array(range);
+        begin_container(range);
+    }
+
+    inline void end_array(const source_range& range)
+    {
+        builder_.end_array(range);
+        end_container(range);
+    }
+
+    inline void begin_inline_table(const source_range& range)
+    {
+        builder_.begin_inline_table(range);
+        begin_container(range);
+    }
+
+    inline void end_inline_table(const source_range& range)
+    {
+        builder_.end_inline_table(range);
+        end_container(range);
+    }
+
+    inline table release()
+    {
+        return builder_.release();
+    }
+
+    inline const std::map<path_type, entry>& entries() const
+    {
+        return entries_;
+    }
+
+    // Where a key added to each table that has a header (or to the root)
+    // goes: just past the table's last key/value line.
+    inline const std::map<path_type, size_t>& sections() const
+    {
+        return sections_;
+    }
+
+    // Tables made by dotted keys have no section of their own; each maps to
+    // the table whose section the key/value line that made it is in.
+    inline const std::map<path_type, path_type>& dotted_tables() const
+    {
+        return dotted_tables_;
+    }
+
+private:
+    inline void begin_container(const source_range& range)
+    {
+        if(depth_++ == 0)
+        {
+            value_begin_ = range.begin;
+        }
+    }
+
+    inline void end_container(const source_range& range)
+    {
+        if(--depth_ == 0)
+        {
+            add_entry(value_begin_, range.end);
+        }
+    }
+
+    inline void add_entry(size_t value_begin, size_t value_end)
+    {
+        if(depth_ != 0 || in_table_array_)
+        {
+            return;
+        }
+
+        size_t line_begin = key_begin_;
+        while(line_begin != 0 && data_[line_begin - 1] != '\n')
+        {
+            --line_begin;
+        }
+
+        entry value_entry = {line_begin, value_begin, value_end, line_end(value_end)};
+
+        path_type path = path_;
+        for(size_t i = 0; i + 1 < key_path_.size(); ++i)
+        {
+            path.push_back(key_path_[i]);
+            dotted_tables_.emplace(path, path_);
+        }
+        path.push_back(key_path_.back());
+        entries_[path] = value_entry;
+
+        sections_[path_] = value_entry.line_end;
+    }
+
+    inline size_t line_end(size_t offset) const
+    {
+        auto newline = static_cast<const char*>(std::memchr(data_ + offset, '\n', size_ - offset));
+        return (newline != nullptr) ? (newline - data_ + 1) : (size_);
+    }
+
+private:
+    const char* data_;
+    size_t size_;
+    table_builder builder_;
+    path_type path_;
+    path_type key_path_;
+    size_t key_begin_;
+    size_t value_begin_;
+    size_t depth_;
+    bool in_table_array_;
+    std::set<path_type> table_arrays_;
+    std::map<path_type, entry> entries_;
+    std::map<path_type, size_t> sections_;
+    std::map<path_type, path_type> dotted_tables_;
+};
+
+// A parsed document that can be edited without rewriting it. Changing a
+// value replaces only that value's bytes, removing a key drops only its
+// line, and new keys are inserted after the last line of their table;
+// comments, ordering and formatting everywhere else are written back as
+// they were read.
+class document
+{
+public:
+    using path_type = document_index::path_type;
+
+    document(std::string source) : source_(std::move(source))
+    {
+        document_index index(source_.data(), source_.size());
+        basic_push_parser<document_index> parser(index);
+        parser.parse(source_.data(), source_.size());
+
+        root_ = index.release();
+        entries_ = index.entries();
+        for(auto& section : index.sections())
+        {
+            sections_[section.first].insert_at = section.second;
+        }
+        dotted_tables_ = index.dotted_tables();
+    }
+
+    document(const document&) = delete;
+    document& operator = (const document&) = delete;
+
+    document(document&&) = default;
+    document& operator = (document&&) = default;
+
+    inline const table& root() const
+    {
+        return root_;
+    }
+
+    // Returns false when path goes through a value that is not a table, an
+    // inline table or an array of tables, or names a table; value must not
+    // be a table either.
+    inline bool set(const path_type& path, std::shared_ptr<base> value)
+    {
+        if(path.empty() || value->is<table>() || inside_value(path))
+        {
+            return false;
+        }
+
+        table* parent = find_parent(path, true);
+        if(parent == nullptr)
+        {
+            return false;
+        }
+
+        auto& data = parent->get();
+        auto find_result = data.find(path.back());
+        if(find_result != data.end() && find_result->second->is<table>())
+        {
+            return false;
+        }
+
+        std::ostringstream text;
+        value->accept(text);
+        data[path.back()] = value;
+
+        auto entry = entries_.find(path);
+        if(entry != entries_.end())
+        {
+            edits_[path] = edit{entry->second.value_begin, entry->second.value_end, text.str()};
+            return true;
+        }
+
+        path_type key;
+        path_type table_path = section_of(path, key);
+        auto section = sections_.find(table_path);
+        if(section == sections_.end())
+        {
+            section = sections_.emplace(table_path, section_edit()).first;
+            new_sections_.push_back(table_path);
+        }
+
+        auto& added = section->second.added;
+        auto added_key = std::find_if(added.begin(), added.end(),
+                [&](const std::pair<path_type, std::string>& key_value){ return key_value.first == key; });
+        if(added_key != added.end())
+        {
+            added_key->second = text.str();
+        }
+        else
+        {
+            added.emplace_back(key, text.str());
+        }
+
+        return true;
+    }
+
+    inline bool set(const path_type& path, const int& value)
+    {
+        return set(path, std::make_shared<int_value>(value));
+    }
+
+    inline bool set(const path_type& path, const int64_t& value)
+    {
+        return set(path, std::make_shared<int_value>(value));
+    }
+
+    inline bool set(const path_type& path, const double& value)
+    {
+        return set(path, std::make_shared<float_value>(value));
+    }
+
+    inline bool set(const path_type& path, const char* value)
+    {
+        return set(path, std::make_shared<string_value>(std::string(value)));
+    }
+
+    inline bool set(const path_type& path, const std::string& value)
+    {
+        return set(path, std::make_shared<string_value>(value));
+    }
+
+    inline bool set(const path_type& path, const bool& value)
+    {
+        return set(path, std::make_shared<bool_value>(value));
+    }
+
+    inline bool set(const path_type& path, const date_time& value)
+    {
+        return set(path, std::make_shared<date_time_value>(value));
+    }
+
+    // Tables can not be removed, only the values in them; members of
+    // inline tables can not be removed either.
+    inline bool remove(const path_type& path)
+    {
+        table* parent = (path.empty() || inside_value(path)) ? (nullptr) : (find_parent(path, false));
+        if(parent == nullptr)
+        {
+            return false;
+        }
+
+        auto& data = parent->get();
+        auto find_result = data.find(path.back());
+        if(find_result == data.end() || find_result->second->is<table>())
+        {
+            return false;
+        }
+        data.erase(find_result);
+
+        auto entry = entries_.find(path);
+        if(entry != entries_.end())
+        {
+            edits_[path] = edit{entry->second.line_begin, entry->second.line_end, std::string()};
+            return true;
+        }
+
+        path_type key;
+        auto& added = sections_[section_of(path, key)].added;
+        auto added_key = std::find_if(added.begin(), added.end(),
+                [&](const std::pair<path_type, std::string>& key_value){ return key_value.first == key; });
+        if(added_key != added.end())
+        {
+            added.erase(added_key);
+        }
+        return true;
+    }
+
+    // Copies the source up to each edit, the edit itself, and so on; tables
+    // that were not in the source are appended at the end.
+    inline void write(std::string& output) const
+    {
+        std::vector<edit> edits;
+        edits.reserve(edits_.size() + sections_.size());
+        for(auto& path_edit : edits_)
+        {
+            edits.push_back(path_edit.second);
+        }
+
+        for(auto& section : sections_)
+        {
+            if(!section.second.added.empty() && section.second.insert_at != npos)
+            {
+                edits.push_back(edit{section.second.insert_at, section.second.insert_at, std::string()});
+                append_keys(section.second, edits.back().text);
+            }
+        }
+
+        std::sort(edits.begin(), edits.end(),
+                [](const edit& lhs, const edit& rhs){ return (lhs.begin != rhs.begin) ? (lhs.begin < rhs.begin) : (lhs.end < rhs.end); });
+
+        output.reserve(output.size() + source_.size());
+        size_t position = 0;
+        for(auto& change : edits)
+        {
+            output.append(source_, position, change.begin - position);
+            if(change.begin == change.end && change.begin != 0 && source_[change.begin - 1] != '\n')
+            {
+                output += '\n';
+            }
+
+            output += change.text;
+            position = change.end;
+        }
+        output.append(source_, position, std::string::npos);
+
+        for(auto& path : new_sections_)
+        {
+            auto& section = sections_.at(path);
+            if(section.added.empty())
+            {
+                continue;
+            }
+
+            if(!output.empty() && output.back() != '\n')
+            {
+                output += '\n';
+            }
+
+            output += '[';
+            append_path(path, output);
+            output += "]\n";
+
+            append_keys(section, output);
+        }
+    }
+
+    inline std::string str() const
+    {
+        std::string output;
+        write(output);
+        return output;
+    }
+
+private:
+    static const size_t npos = static_cast<size_t>(-1);
+
+    struct edit
+    {
+        size_t begin;
+        size_t end;
+        std::string text;
+    };
+
+    struct section_edit
+    {
+        section_edit() : insert_at(npos)
+        {}
+
+        size_t insert_at;
+        std::vector<std::pair<path_type, std::string>> added;
+    };
+
+    // Inline tables and arrays are indexed as one value, so their members
+    // can not be edited on their own.
+    inline bool inside_value(const path_type& path) const
+    {
+        path_type prefix;
+        for(size_t i = 0; i + 1 < path.size(); ++i)
+        {
+            prefix.push_back(path[i]);
+            if(entries_.count(prefix) != 0)
+            {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    inline table* find_parent(const path_type& path, bool create)
+    {
+        table* current = &root_;
+        for(size_t i = 0; i + 1 < path.size(); ++i)
+        {
+            auto& data = current->get();
+            auto find_result = data.find(path[i]);
+            if(find_result == data.end())
+            {
+                if(!create)
+                {
+                    return nullptr;
+                }
+
+                auto child = std::make_shared<table>();
+                data.emplace(path[i], child);
+                current = child.get();
+            }
+            else if(find_result->second->is<table>())
+            {
+                current = static_cast<table*>(find_result->second.get());
+            }
+            else
+            {
+                return nullptr;
+            }
+        }
+
+        return current;
+    }
+
+    // Keys of tables made by dotted keys are added the same way, to the
+    // section the dotted keys were in; a header for such a table would
+    // define it a second time.
+    inline path_type section_of(const path_type& path, path_type& key) const
+    {
+        path_type table_path(path.begin(), path.end() - 1);
+        key.assign(1, path.back());
+
+        auto owner = dotted_tables_.find(table_path);
+        if(owner != dotted_tables_.end())
+        {
+            key.insert(key.begin(), table_path.begin() + owner->second.size(), table_path.end());
+            table_path = owner->second;
+        }
+
+        return table_path;
+    }
+
+    inline static void append_path(const path_type& path, std::string& output)
+    {
+        for(size_t i = 0; i < path.size(); ++i)
+        {
+            output += (i == 0) ? ("") : (".");
+            output += format_key(path[i]);
+        }
+    }
+
+    inline static void append_keys(const section_edit& section, std::string& output)
+    {
+        for(auto& key_value : section.added)
+        {
+            append_path(key_value.first, output);
+            output += " = ";
+            output += key_value.second;
+            output += '\n';
+        }
+    }
+
+private:
+    std::string source_;
+    table root_;
+    std::map<path_type, document_index::entry> entries_;
+    std::map<path_type, section_edit> sections_;
+    std::map<path_type, path_type> dotted_tables_;
+    std::vector<path_type> new_sections_;
+    std::map<path_type, edit> edits_;
+};
+
+} // namespace toml
+
+#endif
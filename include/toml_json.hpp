@@ -0,0 +1,996 @@
+#ifndef __TOML_JSON_HPP__
+#define __TOML_JSON_HPP__
+
+#include "toml.hpp"
+
+#include <cerrno>
+#include <cstdlib>
+#include <set>
+
+namespace toml
+{
+
+// Handler of basic_push_parser that writes the values it is given as JSON
+// straight into an output buffer.
+class json_writer
+{
+public:
+    json_writer(std::string& output) : output_(output)
+    {}
+
+    inline void begin_object()
+    {
+        before_value();
+        output_ += '{';
+        levels_.push_back(level(false));
+    }
+
+    inline void end_object()
+    {
+        output_ += '}';
+        levels_.pop_back();
+    }
+
+    inline void member(const std::string& key)
+    {
+        if(!levels_.back().first)
+        {
+            output_ += ',';
+        }
+        levels_.back().first = false;
+
+        append_quoted(output_, key);
+        output_ += ':';
+    }
+
+    inline void table_header(const std::vector<std::string>&, const source_range&)
+    {}
+
+    inline void array_table_header(const std::vector<std::string>&, const source_range&)
+    {}
+
+    // Outside inline tables a dotted key is fed in with the object of the
+    // table it goes into already open (see section_index).
+    inline void key(const std::vector<std::string>& path, const source_range&)
+    {
+        level& top = levels_.back();
+        if(!top.inline_table)
+        {
+            member(path.back());
+            return;
+        }
+
+        top.dotted = top.dotted || path.size() > 1;
+        top.members.push_back(member_span{path, output_.size(), 0});
+        member(path.back());
+        top.members.back().value_begin = output_.size();
+    }
+
+    inline void integer(int64_t value, const source_range&)
+    {
+        before_value();
+        append_integer(value);
+    }
+
+    // JSON has no inf or nan, so those are written as strings.
+    inline void floating(double value, const source_range&)
+    {
+        char buffer[float_formatter::buffer_size];
+        size_t size = float_formatter::format(value, buffer);
+
+        before_value();
+        if(std::isfinite(value))
+        {
+            output_.append(buffer, size);
+        }
+        else
+        {
+            append_quoted(output_, buffer, size);
+        }
+    }
+
+    inline void string(const char* data, size_t size, const source_range&)
+    {
+        before_value();
+        append_quoted(output_, data, size);
+    }
+
+    inline void boolean(bool value, const source_range&)
+    {
+        before_value();
+        output_ += (value) ? ("true") : ("false");
+    }
+
+    inline void begin_array(const source_range&)
+    {
+        before_value();
+        output_ += '[';
+        levels_.push_back(level(true));
+    }
+
+    inline void end_array(const source_range&)
+    {
+        output_ += ']';
+        levels_.pop_back();
+    }
+
+    inline void begin_inline_table(const source_range&)
+    {
+        begin_object();
+        levels_.back().inline_table = true;
+        levels_.back().begin = output_.size();
+    }
+
+    inline void end_inline_table(const source_range&)
+    {
+        if(levels_.back().dotted)
+        {
+            gather_dotted(levels_.back());
+        }
+        end_object();
+    }
+
+    inline void date(const date_time& value, const source_range&)
+    {
+        char buffer[32];
+        size_t size = value.format(buffer);
+
+        before_value();
+        append_quoted(output_, buffer, size);
+    }
+
+private:
+    struct member_span
+    {
+        std::vector<std::string> path;
+        size_t begin;
+        size_t value_begin;
+    };
+
+    struct level
+    {
+        level(bool is_array) : first(true), array(is_array), inline_table(false), dotted(false), begin(0)
+        {}
+
+        bool first;
+        bool array;
+        bool inline_table;
+        bool dotted;
+        size_t begin;
+        std::vector<member_span> members;
+    };
+
+    // A table made by dotted keys in an inline table, or one of its values.
+    struct dotted_node
+    {
+        std::string name;
+        size_t value_begin;
+        size_t value_end;
+        bool table;
+        std::vector<size_t> children;
+        std::unordered_map<std::string, size_t> child_index;
+    };
+
+    // Dotted keys spread the members of a table over the whole inline table,
+    // as in {a.x = 1, b = 2, a.y = 3}; once it is closed, the members that
+    // were written are gathered into their objects, in the order they came.
+    inline void gather_dotted(const level& top)
+    {
+        std::vector<dotted_node> nodes(1);
+        nodes[0].table = true;
+        for(size_t i = 0; i < top.members.size(); ++i)
+        {
+            auto& span = top.members[i];
+            size_t current = 0;
+            for(size_t j = 0; j < span.path.size(); ++j)
+            {
+                auto find_result = nodes[current].child_index.find(span.path[j]);
+                if(find_result != nodes[current].child_index.end())
+                {
+                    current = find_result->second;
+                    continue;
+                }
+
+                size_t child = nodes.size();
+                bool is_value = (j + 1 == span.path.size());
+                size_t value_end = (i + 1 < top.members.size()) ? (top.members[i + 1].begin) : (output_.size());
+                nodes.push_back(dotted_node{span.path[j], span.value_begin, value_end, !is_value, {}, {}});
+                nodes[current].children.push_back(child);
+                nodes[current].child_index.emplace(span.path[j], child);
+                current = child;
+            }
+        }
+
+        std::string members(output_, top.begin);
+        output_.resize(top.begin);
+        write_dotted(nodes, 0, members, top.begin);
+    }
+
+    inline void write_dotted(const std::vector<dotted_node>& nodes, size_t index, const std::string& members, size_t offset)
+    {
+        bool first = true;
+        for(auto child : nodes[index].children)
+        {
+            if(!first)
+            {
+                output_ += ',';
+            }
+            first = false;
+
+            auto& node = nodes[child];
+            append_quoted(output_, node.name);
+            output_ += ':';
+            if(node.table)
+            {
+                output_ += '{';
+                write_dotted(nodes, child, members, offset);
+                output_ += '}';
+            }
+            else
+            {
+                output_.append(members, node.value_begin - offset, node.value_end - node.value_begin);
+            }
+        }
+    }
+
+    inline void before_value()
+    {
+        if(levels_.empty() || !levels_.back().array)
+        {
+            return;
+        }
+
+        if(!levels_.back().first)
+        {
+            output_ += ',';
+        }
+        levels_.back().first = false;
+    }
+
+    template<class integer_type>
+    inline void append_integer(integer_type value)
+    {
+        char buffer[24];
+        char* digits = buffer + sizeof(buffer);
+
+        auto magnitude = static_cast<unsigned long long>(value);
+        if(value < 0)
+        {
+            magnitude = 0 - magnitude;
+        }
+
+        do
+        {
+            *(--digits) = static_cast<char>('0' + magnitude % 10);
+            magnitude /= 10;
+        } while(magnitude != 0);
+
+        if(value < 0)
+        {
+            *(--digits) = '-';
+        }
+
+        output_.append(digits, buffer + sizeof(buffer));
+    }
+
+private:
+    std::string& output_;
+    std::vector<level> levels_;
+};
+
+// Handler of basic_push_parser that records which byte ranges of a document
+// belong to which table. A table may be continued after other tables
+// (`[a]`, `[b]`, `[a.c]`), so its JSON object can only be closed once the whole
+// document has been seen; keeping ranges instead of values bounds that buffering
+// to the number of table headers. A statement with a dotted key is a range of
+// the table the key goes into, and each [[a]] is a table of its own.
+class section_index
+{
+public:
+    struct section
+    {
+        section() : defined(false), dotted(false), array(false)
+        {}
+
+        std::vector<std::pair<size_t, size_t>> ranges;
+        std::vector<std::pair<std::string, size_t>> children;
+        std::unordered_map<std::string, size_t> child_index;
+        std::unordered_set<std::string> keys;
+        std::vector<size_t> elements;
+        bool defined;
+        bool dotted;
+        bool array;
+    };
+
+    section_index() : sections_(1), current_(0), open_(0)
+    {
+        sections_[0].ranges.emplace_back(0, 0);
+        sections_[0].defined = true;
+    }
+
+    inline void table_header(const std::vector<std::string>& path, const source_range& range)
+    {
+        size_t current = child(resolve_parent(path, range), path.back(), range);
+        if(sections_[current].array)
+        {
+            throw parse_exception("key is not a table:" + path.back(), range.line);
+        }
+
+        if(sections_[current].defined || sections_[current].dotted)
+        {
+            throw parse_exception("table is already defined:" + path.back(), range.line);
+        }
+
+        sections_[current].defined = true;
+        begin_section(current, range);
+    }
+
+    inline void array_table_header(const std::vector<std::string>& path, const source_range& range)
+    {
+        size_t parent = resolve_parent(path, range);
+        auto find_result = sections_[parent].child_index.find(path.back());
+        size_t tables = 0;
+        if(find_result == sections_[parent].child_index.end() && sections_[parent].keys.count(path.back()) == 0)
+        {
+            tables = add_child(parent, path.back());
+            sections_[tables].array = true;
+        }
+        else if(find_result != sections_[parent].child_index.end() && sections_[find_result->second].array)
+        {
+            tables = find_result->second;
+        }
+        else
+        {
+            throw parse_exception("key is not an array of tables:" + path.back(), range.line);
+        }
+
+        size_t element = sections_.size();
+        sections_.emplace_back();
+        sections_[element].defined = true;
+        sections_[tables].elements.push_back(element);
+        begin_section(element, range);
+    }
+
+    // Keys are checked here, as the writer can not take back a member once
+    // it is written.
+    inline void key(const std::vector<std::string>& path, const source_range& range)
+    {
+        if(!inline_keys_.empty())
+        {
+            inline_key(path, range);
+            return;
+        }
+
+        // Dotted keys may only go on through tables that other dotted keys
+        // made, or that a header only implied.
+        size_t target = current_;
+        for(size_t i = 0; i + 1 < path.size(); ++i)
+        {
+            auto find_result = sections_[target].child_index.find(path[i]);
+            if(find_result == sections_[target].child_index.end())
+            {
+                target = child(target, path[i], range);
+                sections_[target].dotted = true;
+                continue;
+            }
+
+            target = find_result->second;
+            if(sections_[target].defined || sections_[target].array)
+            {
+                throw parse_exception("table is already defined:" + path[i], range.line);
+            }
+        }
+
+        auto& name = path.back();
+        auto& current = sections_[target];
+        if(current.child_index.count(name) != 0 || !current.keys.insert(name).second)
+        {
+            throw parse_exception("duplicate key:" + name, range.line);
+        }
+
+        if(target != open_)
+        {
+            sections_[open_].ranges.back().second = range.begin;
+            sections_[target].ranges.emplace_back(range.begin, range.begin);
+            open_ = target;
+        }
+    }
+
+    inline void integer(int64_t, const source_range&)
+    {}
+
+    inline void floating(double, const source_range&)
+    {}
+
+    inline void string(const char*, size_t, const source_range&)
+    {}
+
+    inline void boolean(bool, const source_range&)
+    {}
+
+    inline void date(const date_time&, const source_range&)
+    {}
+
+    inline void begin_array(const source_range&)
+    {
+        inline_keys_.emplace_back();
+    }
+
+    inline void end_array(const source_range&)
+    {
+        inline_keys_.pop_back();
+    }
+
+    inline void begin_inline_table(const source_range&)
+    {
+        inline_keys_.emplace_back();
+    }
+
+    inline void end_inline_table(const source_range&)
+    {
+        inline_keys_.pop_back();
+    }
+
+    inline void finish(size_t size)
+    {
+        sections_[open_].ranges.back().second = size;
+    }
+
+    inline const std::vector<section>& sections() const
+    {
+        return sections_;
+    }
+
+private:
+    using path_type = std::vector<std::string>;
+
+    // The values and the tables dotted keys made in one inline table.
+    struct inline_level
+    {
+        std::set<path_type> values;
+        std::set<path_type> tables;
+    };
+
+    inline void inline_key(const path_type& path, const source_range& range)
+    {
+        auto& level = inline_keys_.back();
+        path_type prefix;
+        for(size_t i = 0; i + 1 < path.size(); ++i)
+        {
+            prefix.push_back(path[i]);
+            if(level.values.count(prefix) != 0)
+            {
+                throw parse_exception("key is not a table:" + path[i], range.line);
+            }
+            level.tables.insert(prefix);
+        }
+
+        if(level.tables.count(path) != 0 || !level.values.insert(path).second)
+        {
+            throw parse_exception("duplicate key:" + path.back(), range.line);
+        }
+    }
+
+    // Tables in an array of tables are reached through its last element.
+    inline size_t resolve_parent(const path_type& path, const source_range& range)
+    {
+        size_t current = 0;
+        for(size_t i = 0; i + 1 < path.size(); ++i)
+        {
+            current = child(current, path[i], range);
+            if(sections_[current].array)
+            {
+                current = sections_[current].elements.back();
+            }
+        }
+
+        return current;
+    }
+
+    inline size_t child(size_t parent, const std::string& name, const source_range& range)
+    {
+        if(sections_[parent].keys.count(name) != 0)
+        {
+            throw parse_exception("key is not a table:" + name, range.line);
+        }
+
+        auto find_result = sections_[parent].child_index.find(name);
+        if(find_result != sections_[parent].child_index.end())
+        {
+            return find_result->second;
+        }
+
+        return add_child(parent, name);
+    }
+
+    inline size_t add_child(size_t parent, const std::string& name)
+    {
+        size_t created = sections_.size();
+        sections_.emplace_back();
+        sections_[parent].child_index.emplace(name, created);
+        sections_[parent].children.emplace_back(name, created);
+        return created;
+    }
+
+    // The header itself is in neither range.
+    inline void begin_section(size_t section, const source_range& range)
+    {
+        sections_[open_].ranges.back().second = range.begin;
+        sections_[section].ranges.emplace_back(range.end, range.end);
+        current_ = section;
+        open_ = section;
+    }
+
+private:
+    std::vector<section> sections_;
+    std::vector<inline_level> inline_keys_;
+    size_t current_;
+    size_t open_;
+};
+
+class json
+{
+public:
+    // The document is read twice: once to index where each table's statements
+    // are, and once more table by table while the JSON is written. No value is
+    // materialized in between, and members keep the order of the document.
+    inline static void from_toml(const char* data, size_t size, std::string& output)
+    {
+        section_index index;
+        {
+            basic_push_parser<section_index> parser(index);
+            parser.feed(data, size);
+            parser.finish();
+        }
+        index.finish(size);
+
+        json_writer writer(output);
+        basic_push_parser<json_writer> parser(writer);
+        write_section(index, 0, data, writer, parser);
+    }
+
+    inline static std::string from_toml(const std::string& toml)
+    {
+        std::string output;
+        from_toml(toml.data(), toml.size(), output);
+        return output;
+    }
+
+    // Objects and arrays may nest max_depth deep, as in the TOML parser.
+    inline static table to_table(const char* data, size_t size, size_t max_depth = basic_push_parser<table_builder>::default_max_depth)
+    {
+        struct frame
+        {
+            table* object;
+            array* elements;
+            std::string key;
+        };
+
+        enum class state
+        {
+            open,
+            next,
+            value,
+            after
+        };
+
+        const char* end = data + size;
+        const char* position = consume_whitespace(data, end);
+        if(position == end || *position != '{')
+        {
+            throw error("expected '{' at the start of the document", data, position);
+        }
+        ++position;
+
+        table root;
+        std::vector<frame> stack(1);
+        stack.back().object = &root;
+        stack.back().elements = nullptr;
+
+        state current_state = state::open;
+        while(!stack.empty())
+        {
+            position = consume_whitespace(position, end);
+            if(position == end)
+            {
+                throw error("unexpected end of document", data, position);
+            }
+
+            frame& top = stack.back();
+            char close = (top.object != nullptr) ? ('}') : (']');
+
+            if(current_state == state::open || current_state == state::after)
+            {
+                if(*position == close)
+                {
+                    ++position;
+                    stack.pop_back();
+                    current_state = state::after;
+                    continue;
+                }
+
+                if(current_state == state::after)
+                {
+                    if(*position != ',')
+                    {
+                        throw error(std::string("expected ',' or '") + close + "'", data, position);
+                    }
+                    ++position;
+                    current_state = state::next;
+                    continue;
+                }
+
+                current_state = state::next;
+            }
+
+            if(current_state == state::next)
+            {
+                if(top.object != nullptr)
+                {
+                    if(*position != '"')
+                    {
+                        throw error("expected a member name", data, position);
+                    }
+
+                    top.key.clear();
+                    position = parse_string(top.key, position, end, data);
+                    position = consume_whitespace(position, end);
+                    if(position == end || *position != ':')
+                    {
+                        throw error("expected ':' after a member name", data, position);
+                    }
+                    ++position;
+                }
+
+                current_state = state::value;
+                continue;
+            }
+
+            if(*position == '{' || *position == '[')
+            {
+                if(stack.size() > max_depth)
+                {
+                    throw error("value is nested too deeply", data, position);
+                }
+
+                frame child;
+                std::shared_ptr<base> container;
+                if(*position == '{')
+                {
+                    auto object = std::make_shared<table>();
+                    child.object = object.get();
+                    child.elements = nullptr;
+                    container = object;
+                }
+                else
+                {
+                    auto elements = std::make_shared<array>();
+                    child.object = nullptr;
+                    child.elements = elements.get();
+                    container = elements;
+                }
+
+                attach(top, container, data, position);
+                stack.emplace_back(std::move(child));
+                ++position;
+                current_state = state::open;
+                continue;
+            }
+
+            position = parse_scalar(top, position, end, data);
+            current_state = state::after;
+        }
+
+        if(consume_whitespace(position, end) != end)
+        {
+            throw error("unexpected character after the document", data, position);
+        }
+
+        return root;
+    }
+
+    inline static table to_table(const std::string& json)
+    {
+        return to_table(json.data(), json.size());
+    }
+
+    inline static std::string to_toml(const std::string& json)
+    {
+        std::ostringstream stream;
+        to_table(json).accept(stream);
+        return stream.str();
+    }
+
+private:
+    inline static void write_section(const section_index& index, size_t section, const char* data,
+                                     json_writer& writer, basic_push_parser<json_writer>& parser)
+    {
+        auto& current = index.sections()[section];
+
+        writer.begin_object();
+        for(auto& range : current.ranges)
+        {
+            parser.feed(data + range.first, range.second - range.first);
+            parser.finish();
+            parser.reset();
+        }
+
+        for(auto& child : current.children)
+        {
+            writer.member(child.first);
+
+            auto& elements = index.sections()[child.second].elements;
+            if(!index.sections()[child.second].array)
+            {
+                write_section(index, child.second, data, writer, parser);
+                continue;
+            }
+
+            const source_range none = {0, 0, 0};
+            writer.begin_array(none);
+            for(auto element : elements)
+            {
+                write_section(index, element, data, writer, parser);
+            }
+            writer.end_array(none);
+        }
+        writer.end_object();
+    }
+
+    template<class frame_type, class value_data>
+    inline static void attach(frame_type& top, const value_data& value, const char* data, const char* position)
+    {
+        if(top.object == nullptr)
+        {
+            top.elements->add(value);
+        }
+        else if(!top.object->add(top.key, value))
+        {
+            throw error("duplicate key:" + top.key, data, position);
+        }
+    }
+
+    template<class frame_type>
+    inline static const char* parse_scalar(frame_type& top, const char* position, const char* end, const char* data)
+    {
+        if(*position == '"')
+        {
+            std::string string;
+            const char* string_end = parse_string(string, position, end, data);
+            attach(top, string, data, position);
+            return string_end;
+        }
+
+        if(match(position, end, "true"))
+        {
+            attach(top, true, data, position);
+            return position + 4;
+        }
+
+        if(match(position, end, "false"))
+        {
+            attach(top, false, data, position);
+            return position + 5;
+        }
+
+        if(match(position, end, "null"))
+        {
+            throw error("null can not be represented in TOML", data, position);
+        }
+
+        return parse_number(top, position, end, data);
+    }
+
+    template<class frame_type>
+    inline static const char* parse_number(frame_type& top, const char* start, const char* end, const char* data)
+    {
+        const char* position = start;
+        if(position != end && *position == '-')
+        {
+            ++position;
+        }
+
+        const char* digits = position;
+        position = consume_digits(position, end);
+        if(position == digits)
+        {
+            throw error("unexpected character", data, start);
+        }
+
+        bool integer = true;
+        if(position != end && *position == '.')
+        {
+            integer = false;
+            digits = ++position;
+            position = consume_digits(position, end);
+            if(position == digits)
+            {
+                throw error("expected digits after '.'", data, position);
+            }
+        }
+
+        if(position != end && (*position == 'e' || *position == 'E'))
+        {
+            integer = false;
+            ++position;
+            if(position != end && (*position == '+' || *position == '-'))
+            {
+                ++position;
+            }
+
+            digits = position;
+            position = consume_digits(position, end);
+            if(position == digits)
+            {
+                throw error("expected digits in exponent", data, position);
+            }
+        }
+
+        std::string number(start, position);
+        if(integer)
+        {
+            errno = 0;
+            int64_t result = std::strtoll(number.c_str(), nullptr, 10);
+            if(errno == ERANGE)
+            {
+                throw error("integer out of range:" + number, data, start);
+            }
+
+            attach(top, result, data, start);
+        }
+        else
+        {
+            double result = std::strtod(number.c_str(), nullptr);
+            attach(top, result, data, start);
+        }
+
+        return position;
+    }
+
+    inline static const char* parse_string(std::string& output, const char* position, const char* end, const char* data)
+    {
+        ++position;
+        while(true)
+        {
+            const char* run = position;
+            while(position != end && *position != '"' && *position != '\\' && static_cast<unsigned char>(*position) >= 0x20)
+            {
+                ++position;
+            }
+            output.append(run, position);
+
+            if(position == end)
+            {
+                throw error("unterminated string", data, position);
+            }
+
+            if(*position == '"')
+            {
+                return position + 1;
+            }
+
+            if(*position != '\\')
+            {
+                throw error("control character in string", data, position);
+            }
+
+            if(++position == end)
+            {
+                throw error("unterminated string", data, position);
+            }
+
+            switch(*position)
+            {
+            case '"': output += '"'; break;
+            case '\\': output += '\\'; break;
+            case '/': output += '/'; break;
+            case 'b': output += '\b'; break;
+            case 'f': output += '\f'; break;
+            case 'n': output += '\n'; break;
+            case 'r': output += '\r'; break;
+            case 't': output += '\t'; break;
+            case 'u':
+                {
+                    uint32_t code_point = parse_hex4(position + 1, end, data);
+                    position += 4;
+                    if(0xD800 <= code_point && code_point <= 0xDBFF)
+                    {
+                        if(end - position < 7 || position[1] != '\\' || position[2] != 'u')
+                        {
+                            throw error("unpaired surrogate in string", data, position);
+                        }
+
+                        uint32_t low = parse_hex4(position + 3, end, data);
+                        if(low < 0xDC00 || 0xDFFF < low)
+                        {
+                            throw error("unpaired surrogate in string", data, position);
+                        }
+
+                        code_point = 0x10000 + ((code_point - 0xD800) << 10) + (low - 0xDC00);
+                        position += 6;
+                    }
+                    else if(0xDC00 <= code_point && code_point <= 0xDFFF)
+                    {
+                        throw error("unpaired surrogate in string", data, position);
+                    }
+
+                    append_utf8(output, code_point);
+                }
+                break;
+            default:
+                throw error("illegal escape sequence in string", data, position);
+            }
+
+            ++position;
+        }
+    }
+
+    inline static uint32_t parse_hex4(const char* position, const char* end, const char* data)
+    {
+        if(end - position < 4)
+        {
+            throw error("unterminated string", data, position);
+        }
+
+        uint32_t result = 0;
+        for(int i = 0; i < 4; ++i)
+        {
+            char c = position[i];
+            result <<= 4;
+            if('0' <= c && c <= '9')
+            {
+                result |= c - '0';
+            }
+            else if('a' <= c && c <= 'f')
+            {
+                result |= c - 'a' + 10;
+            }
+            else if('A' <= c && c <= 'F')
+            {
+                result |= c - 'A' + 10;
+            }
+            else
+            {
+                throw error("illegal \\u escape in string", data, position);
+            }
+        }
+
+        return result;
+    }
+
+    inline static bool match(const char* position, const char* end, const char* literal)
+    {
+        size_t length = std::strlen(literal);
+        return static_cast<size_t>(end - position) >= length && std::memcmp(position, literal, length) == 0;
+    }
+
+    inline static const char* consume_digits(const char* position, const char* end)
+    {
+        while(position != end && '0' <= *position && *position <= '9')
+        {
+            ++position;
+        }
+
+        return position;
+    }
+
+    inline static const char* consume_whitespace(const char* position, const char* end)
+    {
+        while(position != end && (*position == ' ' || *position == '\t' || *position == '\n' || *position == '\r'))
+        {
+            ++position;
+        }
+
+        return position;
+    }
+
+    inline static parse_exception error(const std::string& message, const char* data, const char* position)
+    {
+        unsigned int line = 1 + static_cast<unsigned int>(std::count(data, position, '\n'));
+        return parse_exception(message, line);
+    }
+};
+
+} // namespace toml
+
+#endif
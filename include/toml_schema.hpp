@@ -0,0 +1,694 @@
+#ifndef __TOML_SCHEMA_HPP__
+#define __TOML_SCHEMA_HPP__
+
+#include "toml.hpp"
+
+#include <map>
+#include <regex>
+
+namespace toml
+{
+
+class compiled_schema;
+
+// What a document may contain: the type of each key, whether it is
+// required, the range of numbers and the pattern strings must match. Keys
+// the schema does not name are not checked. Rules under a key whose type is
+// array apply to each table in that array.
+class schema
+{
+public:
+    using path_type = std::vector<std::string>;
+
+    // A min or max. Integer bounds stay integers, so that integers are
+    // compared with them exactly, however large.
+    struct bound
+    {
+        bound() : set(false), integer(false), integer_value(0), floating_value(0)
+        {}
+
+        inline void assign(int64_t value)
+        {
+            set = true;
+            integer = true;
+            integer_value = value;
+        }
+
+        inline void assign(double value)
+        {
+            set = true;
+            integer = false;
+            floating_value = value;
+        }
+
+        bool set;
+        bool integer;
+        int64_t integer_value;
+        double floating_value;
+    };
+
+    struct field
+    {
+        field() : typed(false), type(base::data_type::integer), required(false), has_pattern(false)
+        {}
+
+        inline field& set_type(base::data_type value_type)
+        {
+            typed = true;
+            type = value_type;
+            return *this;
+        }
+
+        inline field& set_range(double low, double high)
+        {
+            minimum.assign(low);
+            maximum.assign(high);
+            return *this;
+        }
+
+        inline field& set_integer_range(int64_t low, int64_t high)
+        {
+            minimum.assign(low);
+            maximum.assign(high);
+            return *this;
+        }
+
+        inline field& set_pattern(const std::string& expression)
+        {
+            has_pattern = true;
+            pattern = expression;
+            return *this;
+        }
+
+        bool typed;
+        base::data_type type;
+        bool required;
+        bound minimum;
+        bound maximum;
+        bool has_pattern;
+        std::string pattern;
+    };
+
+    inline field& add(const path_type& path)
+    {
+        return fields_[path];
+    }
+
+    inline field& add(const path_type& path, base::data_type type, bool required = false)
+    {
+        field& added = fields_[path];
+        added.set_type(type);
+        added.required = required;
+        return added;
+    }
+
+    // A schema document describes each key with a table that has a type:
+    //
+    //   [server.port]
+    //   type = "integer"   # float, string, boolean, datetime, array, table
+    //   required = true
+    //   min = 1
+    //   max = 65535
+    //
+    //   [server.host]
+    //   type = "string"
+    //   pattern = "[a-z0-9.-]+"
+    //
+    // Tables without a type only group the keys under them.
+    inline static schema from_toml(table& description)
+    {
+        schema result;
+        result.add_fields(description, path_type());
+        return result;
+    }
+
+    inline static schema parse_str(const std::string& str)
+    {
+        table description = parse::parse_str(str);
+        return from_toml(description);
+    }
+
+    inline const std::map<path_type, field>& fields() const
+    {
+        return fields_;
+    }
+
+    inline compiled_schema compile() const;
+
+    inline compiled_schema compile(size_t pattern_limit) const;
+
+private:
+    inline void add_fields(table& description, const path_type& path)
+    {
+        for(auto& member : description)
+        {
+            auto child = std::dynamic_pointer_cast<table>(member.second);
+            if(!child)
+            {
+                continue;
+            }
+
+            path_type child_path(path);
+            child_path.push_back(member.first);
+            if(child->has("type"))
+            {
+                add_field(*child, child_path);
+            }
+            add_fields(*child, child_path);
+        }
+    }
+
+    inline void add_field(table& description, const path_type& path)
+    {
+        auto type = std::dynamic_pointer_cast<const string_value>(description["type"]);
+        if(!type)
+        {
+            throw parse_exception("type must be a string:" + path.back());
+        }
+
+        static const std::pair<const char*, base::data_type> types[] = {
+            {"integer", base::data_type::integer},
+            {"float", base::data_type::floaing},
+            {"string", base::data_type::string},
+            {"boolean", base::data_type::boolean},
+            {"datetime", base::data_type::date},
+            {"array", base::data_type::array},
+            {"table", base::data_type::table}
+        };
+
+        auto found = std::find_if(std::begin(types), std::end(types),
+                [&](const std::pair<const char*, base::data_type>& name_type){ return type->get() == name_type.first; });
+        if(found == std::end(types))
+        {
+            throw parse_exception("unknown type:" + type->get());
+        }
+
+        field& added = add(path, found->second);
+        for(auto& member : description)
+        {
+            if(member.first == "required")
+            {
+                auto required = std::dynamic_pointer_cast<const bool_value>(member.second);
+                if(!required)
+                {
+                    throw parse_exception("required must be a boolean:" + path.back());
+                }
+                added.required = required->get();
+            }
+            else if(member.first == "min" || member.first == "max")
+            {
+                bound& limit = (member.first == "min") ? (added.minimum) : (added.maximum);
+                if(member.second->is<int64_t>())
+                {
+                    limit.assign(static_cast<const int_value&>(*member.second).get());
+                }
+                else if(member.second->is<double>())
+                {
+                    limit.assign(static_cast<const float_value&>(*member.second).get());
+                }
+                else
+                {
+                    throw parse_exception("min and max must be numbers:" + path.back());
+                }
+            }
+            else if(member.first == "pattern")
+            {
+                auto pattern = std::dynamic_pointer_cast<const string_value>(member.second);
+                if(!pattern)
+                {
+                    throw parse_exception("pattern must be a string:" + path.back());
+                }
+                added.set_pattern(pattern->get());
+            }
+        }
+    }
+
+private:
+    std::map<path_type, field> fields_;
+};
+
+// A schema turned into a tree of hash maps, one per table, so checking a
+// key is one lookup per key segment while the document is parsed.
+class compiled_schema
+{
+public:
+    static const size_t npos = static_cast<size_t>(-1);
+
+    struct node
+    {
+        node(const std::string& node_name) : name(node_name), end(0)
+        {}
+
+        std::string name;
+        schema::field rule;
+        std::regex pattern;
+        std::unordered_map<std::string, size_t> children;
+        std::vector<size_t> required;
+
+        // Nodes are in pre-order; [index + 1, end) is the subtree.
+        size_t end;
+    };
+
+    // std::regex backtracks and recurses once per character, so strings
+    // longer than pattern_limit are rejected instead of matched; a larger
+    // limit needs a larger stack.
+    static const size_t default_pattern_limit = 1024;
+
+    compiled_schema(const schema& source, size_t pattern_limit = default_pattern_limit) : pattern_limit_(pattern_limit)
+    {
+        nodes_.emplace_back(std::string());
+
+        // std::map orders each path right before the paths under it.
+        for(auto& path_field : source.fields())
+        {
+            size_t current = 0;
+            for(auto& key : path_field.first)
+            {
+                auto found = nodes_[current].children.find(key);
+                if(found != nodes_[current].children.end())
+                {
+                    current = found->second;
+                    continue;
+                }
+
+                std::string name = (current == 0) ? (key) : (nodes_[current].name + "." + key);
+                nodes_[current].children.emplace(key, nodes_.size());
+                current = nodes_.size();
+                nodes_.emplace_back(name);
+            }
+
+            node& compiled = nodes_[current];
+            compiled.rule = path_field.second;
+            if(compiled.rule.has_pattern)
+            {
+                try
+                {
+                    compiled.pattern.assign(compiled.rule.pattern, std::regex::ECMAScript | std::regex::optimize);
+                }
+                catch(const std::regex_error& e)
+                {
+                    throw parse_exception("invalid pattern:" + compiled.name + ":" + e.what());
+                }
+            }
+        }
+
+        for(size_t i = nodes_.size(); i-- != 0;)
+        {
+            nodes_[i].end = i + 1;
+            for(auto& child : nodes_[i].children)
+            {
+                nodes_[i].end = std::max(nodes_[i].end, nodes_[child.second].end);
+                if(nodes_[child.second].rule.required)
+                {
+                    nodes_[i].required.push_back(child.second);
+                }
+            }
+            std::sort(nodes_[i].required.begin(), nodes_[i].required.end());
+        }
+    }
+
+    inline size_t size() const
+    {
+        return nodes_.size();
+    }
+
+    inline size_t pattern_limit() const
+    {
+        return pattern_limit_;
+    }
+
+    inline const node& at(size_t index) const
+    {
+        return nodes_[index];
+    }
+
+    inline size_t child(size_t parent, const std::string& key) const
+    {
+        if(parent == npos)
+        {
+            return npos;
+        }
+
+        auto found = nodes_[parent].children.find(key);
+        if(found == nodes_[parent].children.end())
+        {
+            return npos;
+        }
+
+        return found->second;
+    }
+
+    // Parses and checks in one pass; the first violation is thrown as a
+    // parse_exception with its line.
+    inline table parse(const char* data, size_t size) const;
+
+    inline table parse(const std::string& str) const
+    {
+        return parse(str.data(), str.size());
+    }
+
+private:
+    std::vector<node> nodes_;
+    size_t pattern_limit_;
+};
+
+inline compiled_schema schema::compile() const
+{
+    return compiled_schema(*this);
+}
+
+inline compiled_schema schema::compile(size_t pattern_limit) const
+{
+    return compiled_schema(*this, pattern_limit);
+}
+
+// Handler of basic_push_parser that checks each key and value against a
+// compiled schema before passing it on to another handler.
+template<class handler_type>
+class schema_validator
+{
+public:
+    using path_type = std::vector<std::string>;
+
+    schema_validator(const compiled_schema& rules, handler_type& handler) :
+        rules_(rules),
+        handler_(handler),
+        header_(0),
+        pending_(compiled_schema::npos),
+        seen_(rules.size(), 0),
+        lines_(rules.size(), 1)
+    {}
+
+    schema_validator(const schema_validator&) = delete;
+    schema_validator& operator = (const schema_validator&) = delete;
+
+    inline void table_header(const path_type& path, const source_range& range)
+    {
+        close_elements(path, range.line);
+        header_ = resolve(0, path, range.line);
+        check_type(header_, base::data_type::table, range.line);
+        handler_.table_header(path, range);
+    }
+
+    inline void array_table_header(const path_type& path, const source_range& range)
+    {
+        close_elements(path, range.line);
+        header_ = resolve(0, path, range.line);
+        check_type(header_, base::data_type::array, range.line);
+        if(header_ != compiled_schema::npos)
+        {
+            begin_element(header_, range.line);
+            elements_.push_back(element{header_, path});
+        }
+        handler_.array_table_header(path, range);
+    }
+
+    inline void key(const path_type& path, const source_range& range)
+    {
+        pending_ = resolve((frames_.empty()) ? (header_) : (frames_.back().node), path, range.line);
+        handler_.key(path, range);
+    }
+
+    inline void integer(int64_t value, const source_range& range)
+    {
+        check_range(value_node(base::data_type::integer, range.line), value, range.line);
+        handler_.integer(value, range);
+    }
+
+    inline void floating(double value, const source_range& range)
+    {
+        check_range(value_node(base::data_type::floaing, range.line), value, range.line);
+        handler_.floating(value, range);
+    }
+
+    inline void string(const char* data, size_t size, const source_range& range)
+    {
+        size_t index = value_node(base::data_type::string, range.line);
+        if(index != compiled_schema::npos && rules_.at(index).rule.has_pattern)
+        {
+            if(size > rules_.pattern_limit())
+            {
+                throw parse_exception("value is longer than the pattern limit of " + std::to_string(rules_.pattern_limit()) + " bytes:" + rules_.at(index).name, range.line);
+            }
+
+            if(!std::regex_match(data, data + size, rules_.at(index).pattern))
+            {
+                throw parse_exception("value does not match pattern:" + rules_.at(index).name, range.line);
+            }
+        }
+        handler_.string(data, size, range);
+    }
+
+    inline void boolean(bool value, const source_range& range)
+    {
+        value_node(base::data_type::boolean, range.line);
+        handler_.boolean(value, range);
+    }
+
+    inline void date(const date_time& value, const source_range& range)
+    {
+        value_node(base::data_type::date, range.line);
+        handler_.date(value, range);
+    }
+
+    // Elements of an array are not checked themselves, but the keys of an
+    // inline table in it are, against the rules under the array's key.
+    inline void begin_array(const source_range& range)
+    {
+        frames_.push_back(frame{value_node(base::data_type::array, range.line), true});
+        handler_.begin_array(range);
+    }
+
+    inline void end_array(const source_range& range)
+    {
+        frames_.pop_back();
+        handler_.end_array(range);
+    }
+
+    inline void begin_inline_table(const source_range& range)
+    {
+        if(!frames_.empty() && frames_.back().array)
+        {
+            size_t tables = frames_.back().node;
+            if(tables != compiled_schema::npos)
+            {
+                begin_element(tables, range.line);
+            }
+            frames_.push_back(frame{tables, false});
+        }
+        else
+        {
+            frames_.push_back(frame{value_node(base::data_type::table, range.line), false});
+        }
+        handler_.begin_inline_table(range);
+    }
+
+    inline void end_inline_table(const source_range& range)
+    {
+        frame closed = frames_.back();
+        frames_.pop_back();
+        if(closed.node != compiled_schema::npos)
+        {
+            check_required(closed.node, range.line);
+        }
+        handler_.end_inline_table(range);
+    }
+
+    // Checks for required keys that are still missing; call it once the
+    // whole document was parsed, with the parser's last line.
+    inline void finish(unsigned int line)
+    {
+        close_elements(path_type(), line);
+        lines_[0] = line;
+        check_required(0, line);
+    }
+
+private:
+    struct frame
+    {
+        size_t node;
+        bool array;
+    };
+
+    struct element
+    {
+        size_t node;
+        path_type path;
+    };
+
+    inline size_t resolve(size_t index, const path_type& path, unsigned int line)
+    {
+        for(auto& key : path)
+        {
+            index = rules_.child(index, key);
+            if(index == compiled_schema::npos)
+            {
+                break;
+            }
+
+            if(!seen_[index])
+            {
+                seen_[index] = 1;
+                lines_[index] = line;
+            }
+        }
+
+        return index;
+    }
+
+    inline size_t value_node(base::data_type type, unsigned int line)
+    {
+        if(!frames_.empty() && frames_.back().array)
+        {
+            return compiled_schema::npos;
+        }
+
+        check_type(pending_, type, line);
+        return pending_;
+    }
+
+    inline void check_type(size_t index, base::data_type type, unsigned int line) const
+    {
+        if(index == compiled_schema::npos || !rules_.at(index).rule.typed || rules_.at(index).rule.type == type)
+        {
+            return;
+        }
+
+        static const char* names[] = {"integer", "float", "string", "boolean", "datetime", "array", "table"};
+        throw parse_exception(std::string("expected ") + names[static_cast<int>(rules_.at(index).rule.type)] + ":" + rules_.at(index).name, line);
+    }
+
+    template<class number_type>
+    inline void check_range(size_t index, number_type value, unsigned int line) const
+    {
+        if(index == compiled_schema::npos)
+        {
+            return;
+        }
+
+        auto& rule = rules_.at(index).rule;
+        if((rule.minimum.set && compare(value, rule.minimum) < 0) || (rule.maximum.set && compare(value, rule.maximum) > 0))
+        {
+            throw parse_exception("value out of range:" + rules_.at(index).name, line);
+        }
+    }
+
+    inline static int compare(int64_t value, const schema::bound& limit)
+    {
+        if(limit.integer)
+        {
+            return (value < limit.integer_value) ? (-1) : ((value > limit.integer_value) ? (1) : (0));
+        }
+
+        return -compare(limit.floating_value, value);
+    }
+
+    inline static int compare(double value, const schema::bound& limit)
+    {
+        if(limit.integer)
+        {
+            return compare(value, limit.integer_value);
+        }
+
+        return (value < limit.floating_value) ? (-1) : ((value > limit.floating_value) ? (1) : (0));
+    }
+
+    // Exact, where converting either side to the other's type could round;
+    // nan compares equal to everything, so it is never out of range.
+    inline static int compare(double value, int64_t limit)
+    {
+        const double two_63 = 9223372036854775808.0;
+        if(std::isnan(value))
+        {
+            return 0;
+        }
+
+        if(value >= two_63)
+        {
+            return 1;
+        }
+
+        if(value < -two_63)
+        {
+            return -1;
+        }
+
+        double whole = std::trunc(value);
+        auto integer = static_cast<int64_t>(whole);
+        if(integer != limit)
+        {
+            return (integer < limit) ? (-1) : (1);
+        }
+
+        return (value < whole) ? (-1) : ((value > whole) ? (1) : (0));
+    }
+
+    // Each table in an array is checked on its own.
+    inline void begin_element(size_t index, unsigned int line)
+    {
+        std::fill(seen_.begin() + index + 1, seen_.begin() + rules_.at(index).end, 0);
+        lines_[index] = line;
+    }
+
+    // Ends the arrays of tables that the header at path is not inside of.
+    inline void close_elements(const path_type& path, unsigned int line)
+    {
+        while(!elements_.empty())
+        {
+            auto& open = elements_.back().path;
+            if(path.size() > open.size() && std::equal(open.begin(), open.end(), path.begin()))
+            {
+                break;
+            }
+
+            check_required(elements_.back().node, line);
+            elements_.pop_back();
+        }
+    }
+
+    // Tables under an array are left to close_elements/end_inline_table.
+    inline void check_required(size_t index, unsigned int line) const
+    {
+        auto& checked = rules_.at(index);
+        for(size_t required : checked.required)
+        {
+            if(!seen_[required])
+            {
+                throw parse_exception("missing required key:" + rules_.at(required).name, (index == 0) ? (line) : (lines_[index]));
+            }
+        }
+
+        for(auto& child : checked.children)
+        {
+            auto& rule = rules_.at(child.second).rule;
+            if(seen_[child.second] && !(rule.typed && rule.type == base::data_type::array))
+            {
+                check_required(child.second, line);
+            }
+        }
+    }
+
+private:
+    const compiled_schema& rules_;
+    handler_type& handler_;
+    size_t header_;
+    size_t pending_;
+    std::vector<char> seen_;
+    std::vector<unsigned int> lines_;
+    std::vector<frame> frames_;
+    std::vector<element> elements_;
+};
+
+inline table compiled_schema::parse(const char* data, size_t size) const
+{
+    table_builder builder;
+    schema_validator<table_builder> validator(*this, builder);
+    basic_push_parser<schema_validator<table_builder>> parser(validator);
+    parser.parse(data, size);
+    validator.finish(parser.line());
+    return builder.release();
+}
+
+} // namespace toml
+
+#endif
@@ -0,0 +1,583 @@
+#ifndef __TOML_SHM_HPP__
+#define __TOML_SHM_HPP__
+
+#include "toml.hpp"
+
+#include <system_error>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace toml
+{
+
+// Layout of a published segment. Everything refers to everything else by
+// byte offset from the start of the segment, so it reads the same at any
+// address in any process.
+namespace shm_layout
+{
+    const uint64_t magic = 0x314C4D4F54534D48ULL;
+
+    struct node
+    {
+        uint32_t type;
+        uint32_t size;
+        uint64_t data;
+    };
+
+    // Members of a table are sorted by key bytes for binary search.
+    struct member
+    {
+        uint64_t key_offset;
+        uint64_t key_size;
+        node value;
+    };
+
+    struct header
+    {
+        uint64_t magic;
+        uint64_t generation;
+        uint64_t size;
+        node root;
+    };
+
+    struct control
+    {
+        uint64_t magic;
+        std::atomic<uint64_t> generation;
+    };
+
+    static_assert(sizeof(node) == 16 && sizeof(member) == 32, "shared layout must not depend on the compiler");
+}
+
+// Read-only view of one value in an attached segment. It keeps the
+// segment mapped for as long as it lives, even after a refresh.
+class shared_value
+{
+public:
+    shared_value() : node_(nullptr)
+    {}
+
+    shared_value(std::shared_ptr<const char> segment, const shm_layout::node* node) : segment_(std::move(segment)), node_(node)
+    {}
+
+    inline bool valid() const
+    {
+        return node_ != nullptr;
+    }
+
+    inline base::data_type get_type() const
+    {
+        return static_cast<base::data_type>(node_->type);
+    }
+
+    inline int64_t as_integer() const
+    {
+        return static_cast<int64_t>(node_->data);
+    }
+
+    inline double as_floating() const
+    {
+        double result;
+        std::memcpy(&result, &node_->data, sizeof(result));
+        return result;
+    }
+
+    inline bool as_boolean() const
+    {
+        return node_->data != 0;
+    }
+
+    inline date_time as_date() const
+    {
+        return date_time::from_raw(node_->data);
+    }
+
+    inline const char* string_data() const
+    {
+        return segment_.get() + node_->data;
+    }
+
+    inline std::string as_string() const
+    {
+        return std::string(string_data(), node_->size);
+    }
+
+    // Number of elements of an array or members of a table.
+    inline size_t size() const
+    {
+        return node_->size;
+    }
+
+    inline shared_value operator[] (size_t index) const
+    {
+        auto elements = reinterpret_cast<const shm_layout::node*>(segment_.get() + node_->data);
+        return shared_value(segment_, elements + index);
+    }
+
+    inline std::string key_at(size_t index) const
+    {
+        auto& found = members()[index];
+        return std::string(segment_.get() + found.key_offset, found.key_size);
+    }
+
+    inline shared_value value_at(size_t index) const
+    {
+        return shared_value(segment_, &members()[index].value);
+    }
+
+    // Returns an invalid value when the table has no such key.
+    inline shared_value find(const std::string& key) const
+    {
+        auto first = members();
+        auto last = first + node_->size;
+        auto found = std::lower_bound(first, last, key,
+                [&](const shm_layout::member& lhs, const std::string& rhs){ return compare(lhs, rhs) < 0; });
+
+        if(found == last || compare(*found, key) != 0)
+        {
+            return shared_value();
+        }
+
+        return shared_value(segment_, &found->value);
+    }
+
+    inline shared_value find_path(const std::vector<std::string>& path) const
+    {
+        shared_value current = *this;
+        for(auto& key : path)
+        {
+            if(!current.valid() || current.get_type() != base::data_type::table)
+            {
+                return shared_value();
+            }
+            current = current.find(key);
+        }
+
+        return current;
+    }
+
+    // Copies the value and everything below it into an ordinary tree.
+    inline std::shared_ptr<base> materialize() const
+    {
+        switch(get_type())
+        {
+        case base::data_type::integer:
+            return std::make_shared<int_value>(as_integer());
+        case base::data_type::floaing:
+            return std::make_shared<float_value>(as_floating());
+        case base::data_type::string:
+            return std::make_shared<string_value>(as_string());
+        case base::data_type::boolean:
+            return std::make_shared<bool_value>(as_boolean());
+        case base::data_type::date:
+            return std::make_shared<date_time_value>(as_date());
+        case base::data_type::array:
+        {
+            auto result = std::make_shared<array>();
+            for(size_t i = 0; i < size(); ++i)
+            {
+                auto element = (*this)[i];
+                switch(element.get_type())
+                {
+                case base::data_type::integer:
+                    result->add(element.as_integer());
+                    break;
+                case base::data_type::floaing:
+                    result->add(element.as_floating());
+                    break;
+                default:
+                    result->add(element.materialize());
+                    break;
+                }
+            }
+            return result;
+        }
+        case base::data_type::table:
+        {
+            auto result = std::make_shared<table>();
+            for(size_t i = 0; i < size(); ++i)
+            {
+                result->add(key_at(i), value_at(i).materialize());
+            }
+            return result;
+        }
+        }
+
+        return nullptr;
+    }
+
+private:
+    inline const shm_layout::member* members() const
+    {
+        return reinterpret_cast<const shm_layout::member*>(segment_.get() + node_->data);
+    }
+
+    inline int compare(const shm_layout::member& lhs, const std::string& rhs) const
+    {
+        size_t size = std::min<size_t>(lhs.key_size, rhs.size());
+        int result = std::memcmp(segment_.get() + lhs.key_offset, rhs.data(), size);
+        if(result != 0)
+        {
+            return result;
+        }
+
+        return (lhs.key_size < rhs.size()) ? (-1) : ((lhs.key_size > rhs.size()) ? (1) : (0));
+    }
+
+private:
+    std::shared_ptr<const char> segment_;
+    const shm_layout::node* node_;
+};
+
+// A table published once per host into POSIX shared memory and attached
+// read-only by any number of processes. Each publish writes a complete new
+// segment "<name>.<generation>" and then bumps the generation in the small
+// control segment "<name>", so readers never see a half-written document;
+// refresh() moves a reader to the newest one. Publishing is meant for a
+// single writer per name.
+class shared_config
+{
+public:
+    shared_config(const std::string& name) : name_(name), control_(nullptr), generation_(0)
+    {
+        int descriptor = shm_open(name_.c_str(), O_RDONLY, 0);
+        if(descriptor < 0)
+        {
+            throw std::system_error(errno, std::generic_category(), "shm_open:" + name_);
+        }
+
+        void* address = mmap(nullptr, sizeof(shm_layout::control), PROT_READ, MAP_SHARED, descriptor, 0);
+        close(descriptor);
+        if(address == MAP_FAILED)
+        {
+            throw std::system_error(errno, std::generic_category(), "mmap:" + name_);
+        }
+
+        control_ = static_cast<const shm_layout::control*>(address);
+        if(control_->magic != shm_layout::magic)
+        {
+            munmap(address, sizeof(shm_layout::control));
+            throw std::runtime_error("not a toml segment:" + name_);
+        }
+
+        try
+        {
+            refresh();
+        }
+        catch(...)
+        {
+            munmap(address, sizeof(shm_layout::control));
+            throw;
+        }
+    }
+
+    shared_config(const shared_config&) = delete;
+    shared_config& operator = (const shared_config&) = delete;
+
+    ~shared_config()
+    {
+        munmap(const_cast<shm_layout::control*>(control_), sizeof(shm_layout::control));
+    }
+
+    inline uint64_t generation() const
+    {
+        return generation_;
+    }
+
+    // Attaches the newest generation if it is not the current one. Values
+    // taken before keep the generation they came from.
+    inline bool refresh()
+    {
+        while(true)
+        {
+            uint64_t latest = control_->generation.load(std::memory_order_acquire);
+            if(latest == generation_ && segment_)
+            {
+                return false;
+            }
+
+            auto segment = map_segment(segment_name(name_, latest));
+            if(segment)
+            {
+                segment_ = std::move(segment);
+                generation_ = latest;
+                return true;
+            }
+
+            // The writer replaced that generation between the two reads.
+            if(control_->generation.load(std::memory_order_acquire) == latest)
+            {
+                throw std::system_error(errno, std::generic_category(), "shm_open:" + segment_name(name_, latest));
+            }
+        }
+    }
+
+    inline shared_value root() const
+    {
+        auto& segment_header = *reinterpret_cast<const shm_layout::header*>(segment_.get());
+        return shared_value(segment_, &segment_header.root);
+    }
+
+    // Returns the new generation. Segments are created with mode (less the
+    // umask); only the owner may read them unless a wider mode is given.
+    inline static uint64_t publish(const std::string& name, const table& document, mode_t mode = 0600)
+    {
+        std::string buffer(sizeof(shm_layout::header), '\0');
+        shm_layout::node root = encode(document, buffer);
+
+        int descriptor = shm_open(name.c_str(), O_RDWR | O_CREAT, mode);
+        if(descriptor < 0)
+        {
+            throw std::system_error(errno, std::generic_category(), "shm_open:" + name);
+        }
+
+        struct stat status;
+        if(fstat(descriptor, &status) != 0 || (status.st_size < static_cast<off_t>(sizeof(shm_layout::control)) &&
+                                               ftruncate(descriptor, sizeof(shm_layout::control)) != 0))
+        {
+            int error = errno;
+            close(descriptor);
+            throw std::system_error(error, std::generic_category(), "ftruncate:" + name);
+        }
+
+        void* address = mmap(nullptr, sizeof(shm_layout::control), PROT_READ | PROT_WRITE, MAP_SHARED, descriptor, 0);
+        close(descriptor);
+        if(address == MAP_FAILED)
+        {
+            throw std::system_error(errno, std::generic_category(), "mmap:" + name);
+        }
+
+        auto control = static_cast<shm_layout::control*>(address);
+        uint64_t previous = (control->magic == shm_layout::magic) ? (control->generation.load(std::memory_order_acquire)) : (0);
+        uint64_t generation = previous + 1;
+
+        shm_layout::header segment_header = {shm_layout::magic, generation, buffer.size(), root};
+        std::memcpy(&buffer[0], &segment_header, sizeof(segment_header));
+
+        try
+        {
+            write_segment(segment_name(name, generation), buffer, mode);
+        }
+        catch(...)
+        {
+            munmap(address, sizeof(shm_layout::control));
+            throw;
+        }
+
+        control->magic = shm_layout::magic;
+        control->generation.store(generation, std::memory_order_release);
+        munmap(address, sizeof(shm_layout::control));
+
+        // Readers still attached to the old generation keep their mapping.
+        if(previous != 0)
+        {
+            shm_unlink(segment_name(name, previous).c_str());
+        }
+
+        return generation;
+    }
+
+    inline static void remove(const std::string& name)
+    {
+        int descriptor = shm_open(name.c_str(), O_RDONLY, 0);
+        if(descriptor >= 0)
+        {
+            void* address = mmap(nullptr, sizeof(shm_layout::control), PROT_READ, MAP_SHARED, descriptor, 0);
+            close(descriptor);
+            if(address != MAP_FAILED)
+            {
+                auto control = static_cast<const shm_layout::control*>(address);
+                shm_unlink(segment_name(name, control->generation.load(std::memory_order_acquire)).c_str());
+                munmap(address, sizeof(shm_layout::control));
+            }
+        }
+
+        shm_unlink(name.c_str());
+    }
+
+private:
+    inline static std::string segment_name(const std::string& name, uint64_t generation)
+    {
+        return name + "." + std::to_string(generation);
+    }
+
+    inline static std::shared_ptr<const char> map_segment(const std::string& name)
+    {
+        int descriptor = shm_open(name.c_str(), O_RDONLY, 0);
+        if(descriptor < 0)
+        {
+            return nullptr;
+        }
+
+        struct stat status;
+        if(fstat(descriptor, &status) != 0 || status.st_size < static_cast<off_t>(sizeof(shm_layout::header)))
+        {
+            close(descriptor);
+            throw std::runtime_error("not a toml segment:" + name);
+        }
+
+        size_t size = static_cast<size_t>(status.st_size);
+        void* address = mmap(nullptr, size, PROT_READ, MAP_SHARED, descriptor, 0);
+        close(descriptor);
+        if(address == MAP_FAILED)
+        {
+            throw std::system_error(errno, std::generic_category(), "mmap:" + name);
+        }
+
+        return std::shared_ptr<const char>(static_cast<const char*>(address), [size](const char* data){ munmap(const_cast<char*>(data), size); });
+    }
+
+    inline static void write_segment(const std::string& name, const std::string& buffer, mode_t mode)
+    {
+        int descriptor = shm_open(name.c_str(), O_RDWR | O_CREAT | O_TRUNC, mode);
+        if(descriptor < 0)
+        {
+            throw std::system_error(errno, std::generic_category(), "shm_open:" + name);
+        }
+
+        if(ftruncate(descriptor, buffer.size()) != 0)
+        {
+            int error = errno;
+            close(descriptor);
+            shm_unlink(name.c_str());
+            throw std::system_error(error, std::generic_category(), "ftruncate:" + name);
+        }
+
+        void* address = mmap(nullptr, buffer.size(), PROT_READ | PROT_WRITE, MAP_SHARED, descriptor, 0);
+        close(descriptor);
+        if(address == MAP_FAILED)
+        {
+            int error = errno;
+            shm_unlink(name.c_str());
+            throw std::system_error(error, std::generic_category(), "mmap:" + name);
+        }
+
+        std::memcpy(address, buffer.data(), buffer.size());
+        munmap(address, buffer.size());
+    }
+
+    // Reserves 8-byte aligned room for count slots and returns its offset.
+    inline static size_t reserve(std::string& buffer, size_t slot_size, size_t count)
+    {
+        buffer.resize((buffer.size() + 7) & ~static_cast<size_t>(7));
+        size_t offset = buffer.size();
+        buffer.resize(offset + slot_size * count);
+        return offset;
+    }
+
+    // Sizes (string bytes, elements, members) must fit the 32 bits a node
+    // has for them.
+    inline static shm_layout::node make_node(base::data_type type, uint64_t data, size_t size = 0)
+    {
+        if(size > std::numeric_limits<uint32_t>::max())
+        {
+            throw std::length_error("value is too large to share:" + std::to_string(size));
+        }
+
+        shm_layout::node result = {static_cast<uint32_t>(type), static_cast<uint32_t>(size), data};
+        return result;
+    }
+
+    inline static shm_layout::node encode(const base& data, std::string& buffer)
+    {
+        switch(data.get_type())
+        {
+        case base::data_type::integer:
+            return make_node(data.get_type(), static_cast<uint64_t>(static_cast<const int_value&>(data).get()));
+        case base::data_type::floaing:
+            return encode_floating(static_cast<const float_value&>(data).get());
+        case base::data_type::string:
+        {
+            auto& string_data = static_cast<const string_value&>(data);
+            size_t offset = buffer.size();
+            buffer.append(string_data.data(), string_data.size());
+            return make_node(data.get_type(), offset, string_data.size());
+        }
+        case base::data_type::boolean:
+            return make_node(data.get_type(), (static_cast<const bool_value&>(data).get()) ? (1) : (0));
+        case base::data_type::date:
+            return make_node(data.get_type(), static_cast<const date_time_value&>(data).get().raw());
+        case base::data_type::array:
+            return encode_array(static_cast<const array&>(data), buffer);
+        case base::data_type::table:
+            return encode_table(static_cast<const table&>(data), buffer);
+        }
+
+        return make_node(data.get_type(), 0);
+    }
+
+    inline static shm_layout::node encode_floating(double value)
+    {
+        uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        return make_node(base::data_type::floaing, bits);
+    }
+
+    inline static shm_layout::node encode_array(const array& data, std::string& buffer)
+    {
+        size_t offset = reserve(buffer, sizeof(shm_layout::node), data.size());
+
+        auto integers = data.get_span_as<int_value>();
+        auto floats = data.get_span_as<float_value>();
+        for(size_t i = 0; i < data.size(); ++i)
+        {
+            shm_layout::node element;
+            if(!integers.empty())
+            {
+                element = make_node(base::data_type::integer, static_cast<uint64_t>(integers[i]));
+            }
+            else if(!floats.empty())
+            {
+                element = encode_floating(floats[i]);
+            }
+            else
+            {
+                element = encode(*data.at(i), buffer);
+            }
+
+            std::memcpy(&buffer[offset + i * sizeof(element)], &element, sizeof(element));
+        }
+
+        return make_node(base::data_type::array, offset, data.size());
+    }
+
+    inline static shm_layout::node encode_table(const table& data, std::string& buffer)
+    {
+        std::vector<const table::container_type::value_type*> members;
+        members.reserve(data.get().size());
+        for(auto& member : data)
+        {
+            members.push_back(&member);
+        }
+
+        std::sort(members.begin(), members.end(),
+                [](const table::container_type::value_type* lhs, const table::container_type::value_type* rhs){ return lhs->first < rhs->first; });
+
+        size_t offset = reserve(buffer, sizeof(shm_layout::member), members.size());
+        for(size_t i = 0; i < members.size(); ++i)
+        {
+            shm_layout::member slot;
+            slot.key_offset = buffer.size();
+            slot.key_size = members[i]->first.size();
+            buffer.append(members[i]->first);
+            slot.value = encode(*members[i]->second, buffer);
+
+            std::memcpy(&buffer[offset + i * sizeof(slot)], &slot, sizeof(slot));
+        }
+
+        return make_node(base::data_type::table, offset, members.size());
+    }
+
+private:
+    std::string name_;
+    const shm_layout::control* control_;
+    std::shared_ptr<const char> segment_;
+    uint64_t generation_;
+};
+
+} // namespace toml
+
+#endif
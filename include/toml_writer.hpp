@@ -0,0 +1,287 @@
+#ifndef __TOML_WRITER_HPP__
+#define __TOML_WRITER_HPP__
+
+#include "toml.hpp"
+
+#include <exception>
+#include <mutex>
+#include <system_error>
+
+#include <climits>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace toml
+{
+
+// Writes a table on several threads. The document is first laid out as a
+// list of items in key order (headers, key/value lines, ranges of elements
+// of large arrays); consecutive items are then grouped into chunks of about
+// grain values each, and the chunks are rendered by the workers into their
+// own buffers. The result is the same for any number of threads.
+class parallel_writer
+{
+public:
+    parallel_writer(unsigned int thread_count = 0, size_t grain = 16384) :
+        thread_count_(thread_count),
+        grain_(std::max<size_t>(grain, 1)),
+        size_(0)
+    {}
+
+    parallel_writer(const parallel_writer&) = delete;
+    parallel_writer& operator = (const parallel_writer&) = delete;
+
+    // The table must not change until write() returns; the chunks are
+    // independent of it afterwards.
+    inline void write(const table& root)
+    {
+        items_.clear();
+        chunks_.clear();
+        size_ = 0;
+
+        lay_out(root, std::string(), false);
+
+        std::vector<size_t> bounds(1, 0);
+        size_t weight = 0;
+        for(size_t i = 0; i < items_.size(); ++i)
+        {
+            weight += items_[i].weight;
+            if(weight >= grain_)
+            {
+                bounds.push_back(i + 1);
+                weight = 0;
+            }
+        }
+        if(bounds.back() != items_.size())
+        {
+            bounds.push_back(items_.size());
+        }
+
+        chunks_.resize(bounds.size() - 1);
+        render(bounds);
+        items_.clear();
+
+        for(auto& chunk : chunks_)
+        {
+            size_ += chunk.size();
+        }
+    }
+
+    inline const std::vector<std::string>& chunks() const
+    {
+        return chunks_;
+    }
+
+    inline size_t size() const
+    {
+        return size_;
+    }
+
+    inline void write_to(std::ostream& stream) const
+    {
+        for(auto& chunk : chunks_)
+        {
+            stream.write(chunk.data(), chunk.size());
+        }
+    }
+
+    inline std::string str() const
+    {
+        std::string output;
+        output.reserve(size_);
+        for(auto& chunk : chunks_)
+        {
+            output += chunk;
+        }
+        return output;
+    }
+
+    // Hands the chunks to the kernel with writev, IOV_MAX at a time,
+    // without joining them first.
+    inline void write_to(int fd) const
+    {
+        std::vector<iovec> vectors;
+        vectors.reserve(chunks_.size());
+        for(auto& chunk : chunks_)
+        {
+            if(!chunk.empty())
+            {
+                vectors.push_back(iovec{const_cast<char*>(chunk.data()), chunk.size()});
+            }
+        }
+
+        size_t index = 0;
+        while(index != vectors.size())
+        {
+            int count = static_cast<int>(std::min<size_t>(vectors.size() - index, IOV_MAX));
+            ssize_t written = ::writev(fd, &vectors[index], count);
+            if(written < 0)
+            {
+                if(errno == EINTR)
+                {
+                    continue;
+                }
+                throw std::system_error(errno, std::generic_category(), "writev");
+            }
+
+            size_t remaining = static_cast<size_t>(written);
+            while(index != vectors.size() && remaining >= vectors[index].iov_len)
+            {
+                remaining -= vectors[index].iov_len;
+                ++index;
+            }
+
+            if(remaining != 0)
+            {
+                vectors[index].iov_base = static_cast<char*>(vectors[index].iov_base) + remaining;
+                vectors[index].iov_len -= remaining;
+            }
+        }
+    }
+
+private:
+    struct item
+    {
+        std::string text;
+        const std::string* key;
+        const base* value;
+        const array* elements;
+        size_t first;
+        size_t last;
+        size_t weight;
+    };
+
+    inline void add_text(std::string text)
+    {
+        items_.push_back(item{std::move(text), nullptr, nullptr, nullptr, 0, 0, 1});
+    }
+
+    // Same layout as table::accept, with the keys of every table sorted.
+    inline void lay_out(const table& current, const std::string& table_name, bool element)
+    {
+        using member = const std::pair<const std::string, std::shared_ptr<base>>;
+
+        std::vector<member*> values;
+        std::vector<member*> children;
+        for(auto& i : current)
+        {
+            bool child = i.second->is<table>() || (i.second->is<array>() && static_cast<const array&>(*i.second).is_table_array());
+            ((child) ? (children) : (values)).push_back(&i);
+        }
+
+        auto by_key = [](const member* lhs, const member* rhs){ return lhs->first < rhs->first; };
+        std::sort(values.begin(), values.end(), by_key);
+        std::sort(children.begin(), children.end(), by_key);
+
+        if(element)
+        {
+            add_text("[[" + table_name + "]]\n");
+        }
+        else if(!table_name.empty() && (!values.empty() || children.empty()))
+        {
+            add_text("[" + table_name + "]\n");
+        }
+
+        for(auto value : values)
+        {
+            const array* elements = (value->second->is<array>()) ? (static_cast<const array*>(value->second.get())) : (nullptr);
+            if(elements == nullptr || elements->size() <= grain_)
+            {
+                items_.push_back(item{std::string(), &value->first, value->second.get(), nullptr, 0, 0, (elements != nullptr) ? (elements->size() + 1) : (1)});
+                continue;
+            }
+
+            add_text(format_key(value->first) + " = [");
+            for(size_t first = 0; first < elements->size(); first += grain_)
+            {
+                size_t last = std::min(first + grain_, elements->size());
+                items_.push_back(item{std::string(), nullptr, nullptr, elements, first, last, last - first});
+            }
+            add_text("]\n");
+        }
+
+        for(auto child : children)
+        {
+            std::string child_name = (table_name.empty()) ? (format_key(child->first)) : (table_name + "." + format_key(child->first));
+            if(child->second->is<table>())
+            {
+                lay_out(static_cast<const table&>(*child->second), child_name, false);
+            }
+            else
+            {
+                for(auto table_element : static_cast<const array&>(*child->second))
+                {
+                    lay_out(static_cast<const table&>(*table_element), child_name, true);
+                }
+            }
+        }
+    }
+
+    inline void render(const std::vector<size_t>& bounds)
+    {
+        std::atomic<size_t> next_index(0);
+        std::exception_ptr error;
+        std::mutex error_mutex;
+
+        auto worker = [&]()
+        {
+            for(size_t index = next_index++; index < chunks_.size(); index = next_index++)
+            {
+                try
+                {
+                    std::ostringstream stream;
+                    for(size_t i = bounds[index]; i < bounds[index + 1]; ++i)
+                    {
+                        render_item(items_[i], stream);
+                    }
+                    chunks_[index] = stream.str();
+                }
+                catch(...)
+                {
+                    std::lock_guard<std::mutex> lock(error_mutex);
+                    error = std::current_exception();
+                }
+            }
+        };
+
+        unsigned int thread_count = (thread_count_ != 0) ? (thread_count_) : (std::max(std::thread::hardware_concurrency(), 1u));
+        thread_count = static_cast<unsigned int>(std::min<size_t>(thread_count, std::max<size_t>(chunks_.size(), 1)));
+
+        thread_joiner threads;
+        threads.start(thread_count - 1, worker);
+        worker();
+        threads.join();
+
+        if(error)
+        {
+            std::rethrow_exception(error);
+        }
+    }
+
+    inline static void render_item(const item& current, std::ostream& stream)
+    {
+        if(current.elements != nullptr)
+        {
+            current.elements->accept_elements(stream, current.first, current.last);
+        }
+        else if(current.value != nullptr)
+        {
+            stream << format_key(*current.key) << " = " << *current.value << '\n';
+        }
+        else
+        {
+            stream << current.text;
+        }
+    }
+
+private:
+    unsigned int thread_count_;
+    size_t grain_;
+    size_t size_;
+    std::vector<item> items_;
+    std::vector<std::string> chunks_;
+};
+
+} // namespace toml
+
+#endif
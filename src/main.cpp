@@ -1,4 +1,9 @@
 #include "../include/toml.hpp"
+#include "../include/toml_json.hpp"
+#include "../include/toml_document.hpp"
+#include "../include/toml_shm.hpp"
+#include "../include/toml_schema.hpp"
+#include "../include/toml_writer.hpp"
 
 #include <iostream>
 
@@ -86,7 +91,661 @@ void table_in_array_test()
   toml::table table_data;
   table_data.add("aa", toml::int_value(1000));
   table_data.add("aaa", toml::string_value("aaaa"));
-  table_data.add("aaaa", toml::date_time_value(toml::date_time::now_from_local()));
+  table_data.add("aaaa", toml::date_time_value(toml::date_time::local_date(2015, 1, 1)));
+  array_data.add(std::make_shared<toml::table>(table_data));
+
+  toml::table root;
+  root.add("array", array_data);
+  std::cout << root << std::endl;
+}
+
+void merge_test()
+{
+  toml::table server;
+  server.add("host", toml::string_value("localhost"));
+  server.add("port", toml::int_value(80));
+
+  toml::table base;
+  base.add("server", server);
+  base.add("ports", toml::array());
+  base.get_as<toml::array>("ports")->add(80);
+
+  toml::table env_server;
+  env_server.add("port", toml::int_value(8080));
+
+  toml::table env;
+  env.add("server", env_server);
+  env.add("ports", toml::array());
+  env.get_as<toml::array>("ports")->add(8080);
+
+  toml::merge_policy policy(toml::array_merge_policy::append);
+  toml::table merged = toml::merge(base, env, policy);
+  std::cout << merged << std::endl;
+
+  merged.get_as<toml::table>("server")->add("debug", true);
+  merged.get_as<toml::array>("ports")->add(443);
+  std::cout << base.get_as<toml::table>("server")->has("debug") << env.get_as<toml::table>("server")->has("debug") << base.get_as<toml::array>("ports")->size() << std::endl;
+
+  // Parts the merge did not change are shared with its inputs until they
+  // are changed through the result.
+  base.add("limits", toml::table());
+  base.get_as<toml::table>("limits")->add("cpu", toml::table());
+  toml::table shared = toml::merge(base, env, policy);
+  const toml::table& const_base = base;
+  const toml::table& const_shared = shared;
+  std::cout << (const_shared["limits"] == const_base["limits"]);
+  shared.get_as<toml::table>("limits")->get_as<toml::table>("cpu")->add("max", 2);
+  std::cout << (const_shared["limits"] == const_base["limits"]) << base.get_as<toml::table>("limits")->get_as<toml::table>("cpu")->has("max") << std::endl;
+
+  toml::overlay_view view(policy);
+  view.add_layer(std::make_shared<toml::table>(base));
+  size_t env_layer = view.add_layer(std::make_shared<toml::table>(env));
+  std::cout << *view.view("server").get_as<toml::int_value>("port") << std::endl;
+  std::static_pointer_cast<toml::table>(view.find("server"))->add("debug", true);
+  std::cout << view.view("server").has("debug") << std::endl;
+
+  env_server.get() = { { "port", std::make_shared<toml::int_value>(9090) } };
+  toml::table reloaded;
+  reloaded.add("server", env_server);
+  view.set_layer(env_layer, std::make_shared<toml::table>(reloaded));
+  std::cout << *view.view("server").get_as<toml::int_value>("port") << ":" << *view.find("ports") << std::endl;
+}
+
+void parse_many_test()
+{
+  std::vector<std::string> documents;
+  for(int i = 0; i < 8; ++i)
+  {
+    documents.emplace_back("index = " + std::to_string(i) + "\nvalue = 1_000\n");
+  }
+  documents.emplace_back("= 1\n");
+
+  auto results = toml::parse::parse_many(documents, 4);
+  for(auto& result : results)
+  {
+    if(result.success)
+    {
+      std::cout << *result.document["index"] << " ";
+    }
+    else
+    {
+      std::cout << "error:" << result.error << std::endl;
+    }
+  }
+}
+
+void push_parser_test()
+{
+  std::string document = "first = 1_000\n# comment\nsecond = -42 # trailing\r\nthird = 7";
+
+  toml::push_parser parser;
+  for(size_t i = 0; i < document.size(); i += 3)
+  {
+    parser.feed(document.data() + i, std::min<size_t>(3, document.size() - i));
+  }
+
+  toml::table result = parser.finish();
+  std::cout << *result["first"] << ":" << *result["second"] << ":" << *result["third"] << std::endl;
+
+  // Statements split anywhere, even inside strings, escapes and comments.
+  std::string split = "a = \"x\\\"# [\" # \"quoted\" [\nb = \"\"\"one\n\"two\"\"\"\"\nc = [\n  '[', # ]\n  {d = 1},\n]\ne = ''\n";
+  toml::push_parser bytes;
+  for(char c : split)
+  {
+    bytes.feed(&c, 1);
+  }
+
+  std::cout << (bytes.finish() == toml::parse::parse_str(split)) << std::endl;
+
+  toml::table dotted = toml::parse::parse_str("a.b.c = 1\nt = {x.y = 1, x.z = 2}\n[a.b.d]\ne = 2\n");
+  std::cout << dotted;
+  for(auto invalid : {"a.b = 1\n[a]\n", "a.b.c = 1\n[a.b]\n", "a = {x = 1}\na.y = 2\n", "a = {x = {}}\n[a.x.y]\n", "[a.b]\n[a]\nb.c = 1\n"})
+  {
+    try
+    {
+      toml::parse::parse_str(invalid);
+    }
+    catch(const toml::parse_exception& e)
+    {
+      std::cout << e.what() << std::endl;
+    }
+  }
+}
+
+void json_test()
+{
+  std::string document = "\
+title = 1\n\
+[a]\n\
+x = 1\n\
+[b.c]\n\
+y = 2\n\
+[a.d]\n\
+z = 3\n\
+";
+
+  std::string json = toml::json::from_toml(document);
+  std::cout << json << std::endl;
+
+  for(auto invalid : {"a = 1\na = 2\n", "a = 1\n[a]\nx = 1\n", "a.b = 1\n[a]\n", "t = {a.b = 1, a = 2}\n", "[[a]]\n[a]\n"})
+  {
+    try
+    {
+      toml::json::from_toml(invalid);
+    }
+    catch(const toml::parse_exception& e)
+    {
+      std::cout << e.what() << std::endl;
+    }
+  }
+
+  try
+  {
+    toml::json::to_table("{\"a\":" + std::string(1000000, '[') + std::string(1000000, ']') + "}");
+  }
+  catch(const toml::parse_exception& e)
+  {
+    std::cout << e.what() << std::endl;
+  }
+
+  std::string empty_tables = toml::json::to_toml("{\"a\":{},\"b\":{\"c\":{}},\"d\":[{\"e\":{}}],\"k\":\"v\"}");
+  toml::table reparsed = toml::parse::parse_str(empty_tables);
+  toml::parallel_writer empty_writer(2, 1);
+  empty_writer.write(reparsed);
+  std::cout << toml::json::from_toml(empty_tables) << ":" << (toml::json::to_table(toml::json::from_toml(empty_writer.str())) == reparsed) << std::endl;
+
+  // Dotted keys and arrays of tables are streamed too, in document order.
+  std::string dotted = "z = 1\na.x = 1\nb = {c.d = 1, e = 2, c.f = 3}\na.y = 2\n[[t]]\nk.l = 1\n[[t]]\n[t.u]\n";
+  std::cout << toml::json::from_toml(dotted) << ":" << (toml::json::to_table(toml::json::from_toml(dotted)) == toml::parse::parse_str(dotted)) << std::endl;
+
+  toml::table table = toml::json::to_table("{\"name\":\"caf\\u00e9\",\"ports\":[80,443],\"server\":{\"port\":8080}}");
+  std::cout << table << std::endl;
+}
+
+void packed_array_test()
+{
+  toml::array weights;
+  for(int64_t i = 0; i < 5; ++i)
+  {
+    weights.add(i * 1000000000000);
+  }
+
+  int64_t sum = 0;
+  for(auto weight : weights.get_span_as<toml::int_value>())
+  {
+    sum += weight;
+  }
+  std::cout << weights.is_packed() << ":" << sum << ":" << weights << std::endl;
+
+  toml::array boxed;
+  for(int64_t i = 0; i < 5; ++i)
+  {
+    boxed.add(std::make_shared<toml::int_value>(i * 1000000000000));
+  }
+
+  const toml::array& packed = weights;
+  int64_t const_sum = 0;
+  for(auto weight : packed)
+  {
+    const_sum += std::static_pointer_cast<toml::int_value>(weight)->get();
+  }
+  std::cout << (const_sum == sum) << (packed == boxed) << weights.is_packed() << boxed.is_packed() << std::endl;
+
+  weights.add("mixed");
+  std::cout << weights.is_packed() << ":" << weights.get_span_as<toml::int_value>().size() << ":" << weights << std::endl;
+
+  toml::table table = toml::json::to_table("{\"histogram\":[0.5,1.5,2.5]}");
+  auto histogram = table.get_as<toml::array>("histogram");
+  std::cout << histogram->get_span_as<toml::float_value>().size() << std::endl;
+}
+
+void date_time_test()
+{
+  std::string document = "\
+odt = 1979-05-27T00:32:00.999-07:00\n\
+ldt = 1979-05-27 07:32:00\n\
+ld = 1979-05-27\n\
+lt = 07:32:00.5\n\
+";
+
+  toml::table table = toml::parse::parse_str(document);
+  auto odt = table.get_as<toml::date_time_value>("odt")->get();
+  std::cout << odt << ":" << odt.year() << "/" << odt.month() << "/" << odt.day() << " " << odt.hour() << ":" << odt.offset() << std::endl;
+  std::cout << *table["ldt"] << ":" << *table["ld"] << ":" << *table["lt"] << std::endl;
+
+  std::vector<toml::date_time> schedule;
+  schedule.push_back(odt + std::chrono::hours(24));
+  schedule.push_back(odt);
+  schedule.push_back(toml::date_time::offset_date_time(1979, 5, 27, 7, 0, 0, 0, 0));
+  std::sort(schedule.begin(), schedule.end());
+  for(auto& date : schedule)
+  {
+    std::cout << date << " ";
+  }
+  std::cout << (schedule[2] - schedule[1]).count() << ":" << sizeof(toml::date_time) << std::endl;
+}
+
+void float_test()
+{
+  toml::table table = toml::parse::parse_str("pi = 3.141592653589793\ntenth = 0.1\nsmall = 5e-324\n");
+  std::cout << *table["pi"] << ":" << *table["tenth"] << ":" << *table["small"] << std::endl;
+
+  toml::array weights;
+  weights.add(1.0 / 3.0);
+  weights.add(2.0 / 3.0);
+  std::cout << weights << std::endl;
+}
+
+void string_test()
+{
+  std::string source = R"([ "quoted header" . inner ]
+basic = "tab\there \u00e9\U0001F600"
+literal = 'C:\path\file'
+"quoted key" = "caf)" "\xc3\xa9" R"("
+multi = """
+first \
+   second ""quoted"""""
+raw = '''
+keep \n as is
+'''
+after = 1
+)";
+
+  toml::table table = toml::parse::parse_str(source);
+  std::stringstream parsed;
+  parsed << table;
+  std::cout << parsed.str() << std::endl;
+
+  toml::push_parser parser;
+  for(size_t i = 0; i < source.size(); i += 3)
+  {
+    parser.feed(source.data() + i, std::min<size_t>(3, source.size() - i));
+  }
+  toml::table pushed = parser.finish();
+  std::stringstream pushed_stream;
+  pushed_stream << pushed;
+  std::cout << (pushed_stream.str() == parsed.str()) << std::endl;
+
+  try
+  {
+    toml::parse::parse_str("bad = \"\xff\"\n");
+  }
+  catch(const toml::parse_exception& e)
+  {
+    std::cout << e.what() << std::endl;
+  }
+}
+
+void string_view_test()
+{
+  std::string source = "name = \"server\"\nescaped = \"a\\tb\"\n[owner]\nlogin = 'admin'\n";
+
+  toml::table table = toml::parse::parse_view(source.data(), source.size());
+  auto name = table.get_as<toml::string_value>("name");
+  auto escaped = table.get_as<toml::string_value>("escaped");
+  std::cout << name->is_view() << ":" << escaped->is_view() << ":" << (name->data() == source.data() + 8) << std::endl;
+  std::cout << table << std::endl;
+
+  auto login = table.get_as<toml::table>("owner")->get_as<toml::string_value>("login");
+  std::shared_ptr<const toml::string_value> const_login = login;
+  std::cout << const_login->get() << ":" << login->is_view() << std::endl;
+
+  std::cout << name->get() << ":" << name->is_view() << std::endl;
+}
+
+void diff_test()
+{
+  toml::table before = toml::parse::parse_str("title = \"app\"\n[server]\nport = 80\nhost = \"a\"\n");
+  toml::table reordered = toml::parse::parse_str("title = \"app\"\n[server]\nhost = \"a\"\nport = 80\n");
+  toml::table after = toml::parse::parse_str("title = \"app\"\n[server]\nport = 8080\nhost = \"a\"\n[cache]\nsize = 1\n");
+
+  toml::array packed;
+  packed.add(1);
+  packed.add(2);
+  toml::array boxed = packed;
+  boxed.box();
+  std::cout << (packed == boxed) << std::endl;
+
+  std::cout << (before.hash() == reordered.hash()) << ":" << (before == reordered) << std::endl;
+
+  const char* kinds[] = {"added", "removed", "changed"};
+  for(auto& change : toml::diff(before, after))
+  {
+    std::string path;
+    for(auto& key : change.path)
+    {
+      path += (path.empty()) ? (key) : ("." + key);
+    }
+    std::cout << kinds[static_cast<int>(change.kind)] << " " << path << std::endl;
+  }
+
+  auto server = after.get_as<toml::table>("server");
+  server->add("timeout", 30);
+  std::cout << (toml::diff(before, after).size()) << std::endl;
+
+  toml::table copy = toml::parse::parse_str("title = \"app\"\n[server]\nport = 80\nhost = \"a\"\n");
+  auto held = copy.get_as<toml::table>("server");
+  std::cout << (before == copy) << toml::diff(before, copy).size() << std::endl;
+  held->add("timeout", 30);
+  held->get_as<toml::int_value>("port")->get() = 81;
+  std::cout << (before == copy) << toml::diff(before, copy).size() << std::endl;
+}
+
+void document_test()
+{
+  std::string source = "\
+# service settings\n\
+name = \"api\"   # shown in logs\n\
+\n\
+[server]\n\
+port = 80\n\
+host = \"localhost\" # keep local\n\
+\n\
+[limits]\n\
+timeout = 30\n\
+";
+
+  toml::document document(source);
+  document.set({"server", "port"}, 8080);
+  document.set({"server", "tls"}, true);
+  document.remove({"limits", "timeout"});
+  document.set({"cache", "size"}, 64);
+  std::cout << document.str();
+  auto server = std::dynamic_pointer_cast<toml::table>(document.root()["server"]);
+  std::cout << *(*server)["port"] << std::endl;
+
+  toml::document inline_table("point = {x = 1, y = 2}\n");
+  std::cout << inline_table.set({"point", "x"}, 5) << inline_table.remove({"point", "y"}) << std::endl;
+  std::cout << inline_table.str();
+
+  // Tables made by dotted keys get new keys the same way, not a header.
+  toml::document dotted("a.b = 1\n\n[x]\nk.l.m = 2\n");
+  dotted.set({"a", "c"}, 2);
+  dotted.set({"x", "k", "l", "n"}, 3);
+  dotted.remove({"x", "k", "l", "m"});
+  std::cout << dotted.str();
+  toml::parse::parse_str(dotted.str());
+}
+
+void shared_config_test()
+{
+  std::string name = "/toml_shared_config_test";
+  toml::table config = toml::parse::parse_str("name = \"api\"\n[server]\nport = 80\nratio = 0.5\n");
+  toml::array weights;
+  weights.add(1);
+  weights.add(2);
+  config.add("weights", weights);
+
+  toml::shared_config::publish(name, config);
+  int descriptor = shm_open((name + ".1").c_str(), O_RDONLY, 0);
+  struct stat status;
+  fstat(descriptor, &status);
+  close(descriptor);
+  std::cout << std::oct << (status.st_mode & 0777) << std::dec << std::endl;
+
+  toml::shared_config reader(name);
+  auto root = reader.root();
+  std::cout << reader.generation() << ":" << root.find("name").as_string() << ":" << root.find_path({"server", "port"}).as_integer()
+            << ":" << root.find("weights")[1].as_integer() << ":" << root.find("missing").valid() << std::endl;
+
+  config.get_as<toml::table>("server")->get()["port"] = std::make_shared<toml::int_value>(8080);
+  toml::shared_config::publish(name, config);
+  std::cout << reader.refresh() << ":" << reader.generation() << ":" << reader.root().find_path({"server", "port"}).as_integer()
+            << ":" << root.find_path({"server", "port"}).as_integer() << std::endl;
+
+  auto copy = std::dynamic_pointer_cast<toml::table>(reader.root().materialize());
+  std::cout << (*copy == config) << std::endl;
+
+  toml::shared_config::remove(name);
+}
+
+void grammar_test()
+{
+  std::string source = R"(title = "grammar"
+enabled = true
+flags = 0xff_ff
+point = { x = 1, y = 2, label.text = "origin" }
+matrix = [
+  [1, 2],  # first row
+  [3, 4],
+]
+mixed = [ "a", { b = false }, [] ]
+site."google.com".rank = 1
+
+[[products]]
+name = "hammer"
+sku = 738594937
+
+[[products]]
+name = "nail"
+sizes = [1.5, 2.5]
+
+[products.vendor]
+name = "acme"
+
+[[products]]
+)";
+
+  toml::table table = toml::parse::parse_str(source);
+  std::cout << table;
+  std::cout << toml::json::from_toml(source) << std::endl;
+
+  std::string deep = "deep = " + std::string(1000000, '[') + std::string(1000000, ']') + "\n";
+  try
+  {
+    toml::parse::parse_str(deep);
+  }
+  catch(const toml::parse_exception& e)
+  {
+    std::cout << e.what() << std::endl;
+  }
+
+  toml::push_parser parser;
+  parser.set_max_depth(2000000);
+  parser.feed(deep);
+  toml::table nested = parser.finish();
+  std::cout << nested.has("deep") << std::endl;
+}
+
+void record_cursor_test()
+{
+  std::string source = R"(title = "log"
+ids = [ 10, 20,
+  30, ]  # trailing comma
+
+[[entries]]
+level = "info"
+message = "started"
+
+[[entries]]
+level = "warn"
+message = "disk \"sda\" is slow"
+
+[entries.detail]
+free = 12
+
+[owner]
+name = "ops"
+)";
+
+  toml::record_cursor entries(source.data(), source.size(), {"entries"});
+  while(entries.next())
+  {
+    std::cout << entries.value();
+  }
+  std::cout << entries.document();
+
+  toml::record_cursor ids(source.data(), source.size(), {"ids"});
+  while(ids.next())
+  {
+    std::cout << ids.value() << std::endl;
+  }
+  std::cout << ids.document().has("ids") << ids.document().has("entries") << std::endl;
+
+  // A key of the same name inside an inline table is not the path.
+  std::string nested = "x = {records = [1, 2]}\ny = 5\nrecords = [10, 20]\n";
+  toml::record_cursor records(nested.data(), nested.size(), {"records"});
+  while(records.next())
+  {
+    std::cout << records.value() << " ";
+  }
+  std::cout << std::endl << records.document();
+
+  for(std::string invalid : {"r = [1]\nr = [2]\n", "r = [1]\n[r.x]\n", "r = [1]\n[[r]]\n"})
+  {
+    try
+    {
+      toml::record_cursor records(invalid.data(), invalid.size(), {"r"});
+      while(records.next())
+      {}
+    }
+    catch(const toml::parse_exception& e)
+    {
+      std::cout << e.what() << std::endl;
+    }
+  }
+}
+
+void schema_test()
+{
+  toml::compiled_schema rules = toml::schema::parse_str(R"(
+[server.host]
+type = "string"
+required = true
+pattern = "[a-z0-9.-]+"
+
+[server.port]
+type = "integer"
+min = 1
+max = 65535
+
+[products]
+type = "array"
+
+[products.name]
+type = "string"
+required = true
+)").compile();
+
+  toml::table config = rules.parse(std::string(R"([server]
+host = "example.com"
+port = 8080
+
+[[products]]
+name = "hammer"
+
+[[products]]
+name = "nail"
+)"));
+  std::cout << config;
+
+  const char* invalid[] = {
+    "[server]\nhost = \"example.com\"\nport = 0\n",
+    "[server]\nhost = \"Example!\"\n",
+    "[server]\nport = \"80\"\n",
+    "[server]\nport = 80\n",
+    "[server]\nhost = \"a\"\n[[products]]\nname = \"hammer\"\n[[products]]\nsku = 1\n"
+  };
+  for(auto source : invalid)
+  {
+    try
+    {
+      rules.parse(std::string(source));
+    }
+    catch(const toml::parse_exception& e)
+    {
+      std::cout << e.what() << std::endl;
+    }
+  }
+
+  try
+  {
+    rules.parse("[server]\nhost = \"" + std::string(200000, 'a') + "\"\n");
+  }
+  catch(const toml::parse_exception& e)
+  {
+    std::cout << e.what() << std::endl;
+  }
+
+  // Integers are compared with integer bounds exactly, past 2^53 too.
+  toml::schema counters;
+  counters.add({"count"}, toml::base::data_type::integer).set_integer_range(9007199254740993, 9007199254740993);
+  counters.add({"name"}, toml::base::data_type::string).set_pattern("[a-z]+");
+  toml::compiled_schema short_names = counters.compile(4);
+  for(auto source : {"count = 9007199254740993\n", "count = 9007199254740992\n", "name = \"abcdef\"\n"})
+  {
+    try
+    {
+      short_names.parse(std::string(source));
+      std::cout << "valid" << std::endl;
+    }
+    catch(const toml::parse_exception& e)
+    {
+      std::cout << e.what() << std::endl;
+    }
+  }
+
+  try
+  {
+    toml::schema broken;
+    broken.add({"name"}, toml::base::data_type::string).set_pattern("[a-z");
+    broken.compile();
+  }
+  catch(const toml::parse_exception& e)
+  {
+    std::cout << e.what() << std::endl;
+  }
+}
+
+void parallel_writer_test()
+{
+  toml::table table = toml::parse::parse_str(R"(title = "fleet"
+ids = [1, 2, 3, 4, 5, 6, 7]
+
+[[hosts]]
+name = "alpha"
+tags = ["a", "b", "c"]
+
+[[hosts]]
+name = "beta"
+
+[limits]
+cpu = 0.5
+memory = 512
+)");
+
+  const toml::table& source = table;
+  toml::parallel_writer writer(4, 4);
+  writer.write(source);
+  std::cout << writer.chunks().size() << ":" << static_cast<const toml::array&>(*source["ids"]).is_packed() << std::endl;
+  std::cout << writer.str();
+  std::cout << (toml::parse::parse_str(writer.str()) == table) << std::endl;
+
+  std::fflush(stdout);
+  writer.write_to(STDOUT_FILENO);
+}
+
+void memory_test()
+{
+  std::string source;
+  for(int i = 0; i < 100; ++i)
+  {
+    source += "[host" + std::to_string(i) + "]\nregion = \"europe-west-central-1\"\nports = [80, 443]\n";
+  }
+
+  toml::table table = toml::parse::parse_str(source);
+  toml::memory_breakdown before = table.memory_usage();
+  table.compact();
+  toml::memory_breakdown after = table.memory_usage();
+
+  std::cout << "nodes:" << before.nodes << " -> " << after.nodes << std::endl;
+  std::cout << "keys:" << before.keys << " -> " << after.keys << std::endl;
+  std::cout << "strings:" << before.strings << " -> " << after.strings << std::endl;
+  std::cout << "containers:" << before.containers << " -> " << after.containers << std::endl;
+  std::cout << (after.total() < before.total()) << (table == toml::parse::parse_str(source)) << std::endl;
+
+  table.compact(true);
+  std::cout << "shared strings:" << after.strings << " -> " << table.memory_usage().strings << std::endl;
 }
 
 int main()
@@ -99,6 +758,42 @@ int main()
   table_test();
   std::cout << "<table_in_table_test>" << std::endl;
   table_in_table_test();
+  std::cout << "<table_in_array_test>" << std::endl;
+  table_in_array_test();
+  std::cout << "<merge_test>" << std::endl;
+  merge_test();
+  std::cout << "<parse_many_test>" << std::endl;
+  parse_many_test();
+  std::cout << "<push_parser_test>" << std::endl;
+  push_parser_test();
+  std::cout << "<json_test>" << std::endl;
+  json_test();
+  std::cout << "<packed_array_test>" << std::endl;
+  packed_array_test();
+  std::cout << "<date_time_test>" << std::endl;
+  date_time_test();
+  std::cout << "<float_test>" << std::endl;
+  float_test();
+  std::cout << "<string_test>" << std::endl;
+  string_test();
+  std::cout << "<string_view_test>" << std::endl;
+  string_view_test();
+  std::cout << "<diff_test>" << std::endl;
+  diff_test();
+  std::cout << "<document_test>" << std::endl;
+  document_test();
+  std::cout << "<shared_config_test>" << std::endl;
+  shared_config_test();
+  std::cout << "<grammar_test>" << std::endl;
+  grammar_test();
+  std::cout << "<record_cursor_test>" << std::endl;
+  record_cursor_test();
+  std::cout << "<schema_test>" << std::endl;
+  schema_test();
+  std::cout << "<parallel_writer_test>" << std::endl;
+  parallel_writer_test();
+  std::cout << "<memory_test>" << std::endl;
+  memory_test();
 
   std::string toml = "\
 number = +1_00  #aaaaa\n\
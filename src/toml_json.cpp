@@ -0,0 +1,59 @@
+#include "../include/toml_json.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+int main(int argc, char* argv[])
+{
+  bool reverse = false;
+  const char* path = nullptr;
+  for(int i = 1; i < argc; ++i)
+  {
+    if(std::strcmp(argv[i], "-r") == 0 || std::strcmp(argv[i], "--reverse") == 0)
+    {
+      reverse = true;
+    }
+    else
+    {
+      path = argv[i];
+    }
+  }
+
+  std::ifstream file;
+  if(path != nullptr)
+  {
+    file.open(path, std::ios::in | std::ios::binary);
+    if(!file)
+    {
+      std::cerr << "can not open file:" << path << std::endl;
+      return 1;
+    }
+  }
+
+  std::istream& input_stream = (path != nullptr) ? (static_cast<std::istream&>(file)) : (std::cin);
+  std::string input((std::istreambuf_iterator<char>(input_stream)), std::istreambuf_iterator<char>());
+
+  try
+  {
+    if(reverse)
+    {
+      std::cout << toml::json::to_toml(input);
+    }
+    else
+    {
+      std::string output;
+      toml::json::from_toml(input.data(), input.size(), output);
+      output += '\n';
+      std::cout << output;
+    }
+  }
+  catch(const std::exception& e)
+  {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+
+  return 0;
+}